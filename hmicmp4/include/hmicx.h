@@ -1,46 +1,457 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <fstream>
 #include <vector>
 #include <map>
 #include <utility>
 #include <cstddef>
+#include <cstdint>
 #include <cctype>
+#include <unordered_map>
+#include <chrono>
+#include <iosfwd>
+#include <memory>
+
+// 🔇 INSTRUMENTATION - all of it compiles to NOTHING unless you ask for it
+//
+// HMICX_LOG_LEVEL (default 0 = silent):
+//   1 = one line per parse / index / file
+//   2 = + one line per info{} / frame block
+//   3 = + one line per color block and pixel body (this is the firehose)
+// e.g. g++ -DHMICX_LOG_LEVEL=2 ...
+//
+// HMICX_ENABLE_STATS (default 1): ParseStats counters + timers. Set to 0 and
+// getStats() stays all zeroes with not a single clock read in the hot path.
+#ifndef HMICX_LOG_LEVEL
+#define HMICX_LOG_LEVEL 0
+#endif
+#ifndef HMICX_ENABLE_STATS
+#define HMICX_ENABLE_STATS 1
+#endif
+
+#define HMICX_LVL_INFO 1
+#define HMICX_LVL_BLOCK 2
+#define HMICX_LVL_TRACE 3
+
+#if HMICX_LOG_LEVEL > 0
+#include <iostream>
+#define HMICX_LOG(level, msg) \
+    do { if ((level) <= HMICX_LOG_LEVEL) std::cout << "[DEBUG] " << msg << '\n'; } while (0)
+#else
+#define HMICX_LOG(level, msg) do {} while (0)
+#endif
+
+#if HMICX_ENABLE_STATS
+#define HMICX_STAT(...) __VA_ARGS__
+#else
+#define HMICX_STAT(...)
+#endif
 
 namespace HMICX {
 
+    // 📊 What a parse cost. Times are nanoseconds; frameNs is summed over all
+    // worker threads, so in parallel mode it can be bigger than totalNs.
+    struct ParseStats {
+        uint64_t bytesRead = 0;  // bytes pushed through the scanner / read for spans
+        uint64_t blocks = 0;     // frame blocks parsed
+        uint64_t commands = 0;   // color blocks that produced a command
+        uint64_t runs = 0;       // PL= spans
+        uint64_t singles = 0;    // P= pixels
+        uint64_t pixels = 0;     // pixels covered (runs counted, not expanded)
+        uint64_t scanNs = 0;     // finding blocks: reading + brace tracking
+        uint64_t frameNs = 0;    // parseFrameBody
+        uint64_t mergeNs = 0;    // parallel merge + palette
+        uint64_t totalNs = 0;    // wall clock
+    };
+    std::ostream& operator<<(std::ostream& os, const ParseStats& st);
+
+    inline uint64_t statClockNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     // 📦 DATA STRUCTURES - KEEPING IT CLEAN
     struct Pixel {
         int x, y;
     };
 
+    // 🎨 PACKED COLORS - 0xRRGGBBAA, decoded ONCE by the parser
+    // (same layout as SDL_PIXELFORMAT_RGBA8888, so it can go straight into a texture)
+    inline uint32_t packRGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+        return (uint32_t(r) << 24) | (uint32_t(g) << 16) | (uint32_t(b) << 8) | uint32_t(a);
+    }
+    inline uint8_t colorR(uint32_t c) { return uint8_t(c >> 24); }
+    inline uint8_t colorG(uint32_t c) { return uint8_t(c >> 16); }
+    inline uint8_t colorB(uint32_t c) { return uint8_t(c >> 8); }
+    inline uint8_t colorA(uint32_t c) { return uint8_t(c); }
+
+    // rgb(r,g,b) / rgba(r,g,b,a) / #rrggbb → packed RGBA (opaque white if it's garbage)
+    uint32_t decodeColor(std::string_view s);
+
+    // 📏 One horizontal span x0..x1 (inclusive, 1-based like the file) on row y
+    // PL= lines stay like this instead of being blown up into one Pixel each
+    struct Run {
+        int x0, x1, y;
+    };
+
+    // 👀 Read-only view of count Ts (std::span is C++20, we're on 17)
+    template <typename T>
+    struct Span {
+        const T* ptr = nullptr;
+        size_t count = 0;
+
+        const T* begin() const { return ptr; }
+        const T* end() const { return ptr + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const T& operator[](size_t i) const { return ptr[i]; }
+    };
+
+    // 🎞️ F1-3,5,9-12{ → {1,3}, {5,5}, {9,12}. Only kept when there's more than
+    // one range - a plain F1-10 is just start/end.
+    using FrameRanges = std::vector<std::pair<int, int>>;
+
+    // Frame membership in O(1): one bit per frame of the hull first..last
+    struct FrameSet {
+        int first = 0, last = -1;
+        std::vector<uint64_t> bits;
+
+        FrameSet() = default;
+        explicit FrameSet(const FrameRanges& ranges);
+
+        bool contains(int f) const {
+            if (f < first || f > last) return false;
+            unsigned i = static_cast<unsigned>(f - first);
+            return (bits[i >> 6] >> (i & 63)) & 1;
+        }
+    };
+
+    // A command doesn't own its pixels - it's a slice of its CommandList's
+    // runs/singles arena. Use list.runsOf(cmd) / list.singlesOf(cmd) to get them.
+    // start/end is the hull of the frames it's on; list.onFrame(cmd, f) is the
+    // real test (it differs for multi-range blocks).
     struct Command {
         int start, end;
-        std::vector<Pixel> pixels;
-        std::string color;
+        uint32_t runOffset, runCount;        // PL= spans (vertical PL= lines become 1-wide runs)
+        uint32_t singleOffset, singleCount;  // P= pixels
+        uint32_t rgba;                       // packed 0xRRGGBBAA
+        uint32_t paletteIndex;               // index into Parser::getPalette()
+        uint32_t frameSet;                   // 0 = every frame start..end, else list.frameSets[frameSet - 1]
     };
 
+    // 🧱 ARENA - every command's runs and singles live back to back in two flat
+    // vectors, so a whole file is three allocations instead of two per command.
+    // Iterating a CommandList iterates its commands.
+    struct CommandList {
+        std::vector<Command> commands;
+        std::vector<Run> runs;
+        std::vector<Pixel> singles;
+        std::vector<FrameSet> frameSets;  // one per multi-range block, shared by all its commands
+
+        Span<Run> runsOf(const Command& c) const { return {runs.data() + c.runOffset, c.runCount}; }
+        Span<Pixel> singlesOf(const Command& c) const { return {singles.data() + c.singleOffset, c.singleCount}; }
+
+        // Total pixels covered, without expanding anything
+        size_t pixelCount(const Command& c) const {
+            size_t n = c.singleCount;
+            for (const Run& r : runsOf(c)) n += static_cast<size_t>(r.x1 - r.x0 + 1);
+            return n;
+        }
+
+        bool onFrame(const Command& c, int f) const {
+            if (f < c.start || f > c.end) return false;
+            return c.frameSet == 0 || frameSets[c.frameSet - 1].contains(f);
+        }
+
+        // 🧩 append another list, rebasing its offsets onto our arena
+        void append(const CommandList& other);
+
+        std::vector<Command>::const_iterator begin() const { return commands.begin(); }
+        std::vector<Command>::const_iterator end() const { return commands.end(); }
+        size_t size() const { return commands.size(); }
+        bool empty() const { return commands.empty(); }
+        const Command& operator[](size_t i) const { return commands[i]; }
+        void clear() {
+            commands.clear();
+            runs.clear();
+            singles.clear();
+            frameSets.clear();
+        }
+    };
+
+    // ⏱️ FRAME INTERVAL INDEX - which commands are on frame f, without testing
+    // every command on every frame. Commands are sorted by start once; walking
+    // forward a frame adds the ones starting there and drops the ones that
+    // ended, so a frame costs O(active + changes) instead of O(commands).
+    // seek() rebuilds from scratch (loops, jumps). active() is command indices
+    // in file order, so drawing them in that order layers exactly like before.
+    // The CommandList must outlive the index and not change under it.
+    class FrameIndex {
+    private:
+        const CommandList* list = nullptr;
+        std::vector<uint32_t> byStart;  // command indices, sorted by (start, index)
+        size_t nextStart = 0;           // first byStart entry not added yet
+        std::vector<uint32_t> live;     // start <= f <= end, file order
+        std::vector<uint32_t> on;       // live minus multi-range commands not on f
+        bool hasFrameSets = false;
+        int cur = 0;
+
+        void filterFrameSets();
+
+    public:
+        FrameIndex() = default;
+        explicit FrameIndex(const CommandList& cmds);
+
+        void seek(int f);  // O(commands started by f)
+        void next();       // f → f + 1
+        // seek() or next(), whichever is cheaper for going to f
+        void moveTo(int f) { if (f == cur + 1) next(); else if (f != cur) seek(f); }
+        int frame() const { return cur; }
+        const std::vector<uint32_t>& active() const { return hasFrameSets ? on : live; }
+    };
+
+    // 🚰 One parsed F..{} block, handed out by Parser::nextBlock()
+    struct FrameBlock {
+        int start = 0, end = 0;  // hull of the frame list
+        FrameRanges ranges;      // set for F1-3,5,... blocks
+        CommandList commands;    // has its own arena
+    };
+
+    // 📍 Where a top-level F..{} block's body sits in the file
+    struct BlockSpan {
+        uint64_t offset;     // first byte after '{'
+        uint64_t length;     // body bytes, excluding the closing '}'
+        int start, end;      // frame range from the F marker (hull if multi-range)
+        FrameRanges ranges{};  // set for F1-3,5,... markers
+
+        bool overlaps(int a, int b) const {
+            if (end < a || start > b) return false;
+            if (ranges.empty()) return true;
+            for (const auto& [lo, hi] : ranges) {
+                if (hi >= a && lo <= b) return true;
+            }
+            return false;
+        }
+    };
+
+    // 🗂️ BLOCK INDEX - where every top-level frame block lives, so frame N can be
+    // parsed without reading everything before it. Saved next to the file as a
+    // small binary .hmicidx sidecar (foo.hmic → foo.hmicidx).
+    struct BlockIndex {
+        uint64_t fileSize = 0;   // size + mtime of the .hmic it was built from,
+        int64_t fileMtime = 0;   // a mismatch means the sidecar is stale
+        BlockSpan header{0, 0, 0, 0};  // info{} body (start/end unused)
+        bool hasHeader = false;
+        std::vector<BlockSpan> blocks;
+    };
+
+    // .hmicidx on-disk layout (little-endian, packed like the HMICP header):
+    // header, blockCount entries, then every entry's rangeCount (start, end)
+    // int32 pairs back to back in entry order
+    struct IndexFileHeader {
+        char magic[7] = {'H', 'M', 'I', 'C', 'I', 'D', 'X'};
+        uint8_t version = 2;  // v2 = multi-range frame lists
+        uint64_t fileSize = 0;
+        int64_t fileMtime = 0;
+        uint64_t headerOffset = 0;
+        uint64_t headerLength = 0;
+        uint8_t hasHeader = 0;
+        uint32_t blockCount = 0;
+    } __attribute__((packed));
+
+    struct IndexFileEntry {
+        uint64_t offset;
+        uint64_t length;
+        int32_t start, end;
+        uint32_t rangeCount;
+    } __attribute__((packed));
+
+    std::string indexPathFor(const std::string& hmicPath);
+    bool saveIndex(const std::string& indexPath, const BlockIndex& index);
+    bool loadIndex(const std::string& indexPath, BlockIndex& index);
+
+    // 🎨 HMICP HEADER - the 24 bytes in front of every .hmicp pixel blob
+    // (little-endian, packed). .hmicp7 is the same file run through zstd.
+    struct HMICPHeader {
+        char magic[5] = {'H', 'M', 'I', 'C', 'P'};
+        uint8_t version = 1;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint16_t fps = 0;
+        uint32_t totalFrames = 0;
+        uint8_t loop = 0;
+        uint8_t reserved[7] = {0};
+    } __attribute__((packed));
+    static_assert(sizeof(HMICPHeader) == 24, "HMICP header must stay 24 bytes");
+
+    // 🔎 PROBE - dimensions/fps/frame count WITHOUT parsing or decompressing the
+    // whole file. Reads only the leading bytes: the info{} block of a .hmic, the
+    // HMICPHeader of a .hmicp, or just enough zstd output for either. The kind
+    // comes from the bytes (zstd magic, "HMICP" magic), not the file name.
+    enum class AssetKind { HMIC, HMIC7, HMICP, HMICP7 };
+    const char* assetKindName(AssetKind kind);
+
+    struct ProbeInfo {
+        AssetKind kind = AssetKind::HMIC;
+        int width = 0, height = 0;  // 0 = not in the header
+        int fps = 0;
+        int frames = 0;
+        bool loop = false;
+        uint64_t fileSize = 0;      // bytes on disk
+        uint64_t bytesRead = 0;     // bytes probe() actually read from disk
+    };
+
+    // Throws runtime_error on unreadable files, truncated headers and text
+    // without an info{} block.
+    ProbeInfo probe(const std::string& path);
+
+    // 🗺️ HOW THE PARSER GETS ITS BYTES
+    // Auto   = mmap regular files, fall back to chunked streaming for pipes/FIFOs
+    // Mmap   = mmap only (throws if the file can't be mapped)
+    // Stream = always use the 8KB chunked reader
+    // zstd input (.hmic7 - detected from the magic bytes, not the name) is always
+    // decompressed on the fly into the chunked reader, whatever the mode says.
+    enum class ParseMode { Auto, Mmap, Stream };
+
+    // 🧠 Tag for parsing bytes that are already in memory: Parser p(FromMemory{}, data)
+    struct FromMemory {};
+
     // 🎯 MAIN PARSER CLASS - THE STAR OF THE SHOW
     class Parser {
     private:
         std::string filepath;  // 🔥 ADDED THIS - CRUCIAL FOR STREAMING!!
         std::string content;   // Only used for non-streaming version
+        ParseMode mode;
+        const char* mapped = nullptr;  // 🗺️ whole file mapped read-only (zero-copy mode)
+        size_t mappedSize = 0;
+        bool ownsMapping = false;      // false = caller's buffer, not ours to munmap
+        
+        // 🌀 zstd input: the compressed bytes (file or memory) are run through a
+        // ZSTD_DStream chunk by chunk, no temp file and no full-size buffer
+        struct ZstdState;
+        std::unique_ptr<ZstdState> zstd;
+        bool compressed = false;
+        bool sniffed = false;  // compressed is known (regular files: constructor, pipes: first read)
+        std::string_view compressedMemory;  // set = compressed bytes come from here, not the file
         std::map<std::string, std::string> header;
-        std::vector<Command> commands;
+        CommandList commands;
+        std::vector<uint32_t> palette;                         // 🎨 unique colors, first-seen order
+        std::unordered_map<uint32_t, uint32_t> paletteLookup;  // packed color → palette index
+        
+        // 🧠 Where the single-pass block scanner is (survives between chunks)
+        struct ScanState {
+            enum State { LOOKING, IN_INFO, IN_FRAME } state = LOOKING;
+            size_t pos = 0;        // next byte to look at in the current window
+            size_t bodyStart = 0;  // first byte of the open block's body
+            int depth = 0;
+            int frameStart = 0, frameEnd = 0;
+            FrameRanges frameRanges;  // only for multi-range markers
+            bool headerDone = false;
+            int framesFound = 0;
+            uint64_t base = 0;     // file offset of window[0] (streaming drops prefixes)
+            bool yielded = false;  // stopped early to hand something back
+            BlockSpan headerSpan{0, 0, 0, 0};  // where info{} was (for the index)
+        } scan;
+        
+        // 🌊 streaming input (kept open between nextBlock() calls)
+        std::ifstream stream;
+        std::string window;
+        bool inputOpen = false;
+        bool inputEof = false;
+        
+        FrameBlock* emitTo = nullptr;  // set = pull mode, stop after one block
+        bool stopOnHeader = false;
+        FrameBlock pending;            // block readHeader() ran into before info{}
+        bool hasPending = false;
+        
+        BlockIndex index;
+        bool indexLoaded = false;
+        
+        ParseStats stats;
+        std::vector<BlockSpan>* collectBlocks = nullptr;  // set = pre-pass, record blocks instead of parsing
+        unsigned threadCount = 1;
         
         // Core parsing methods (implementation in .cpp)
-        void parseHeader();
-        void parseHeaderBody(const char* body, size_t len);
-        void parseFrames();
-        void parseFrameBody(const char* body, size_t len, int start, int end);
-        std::vector<Pixel> parsePixels(const char* body, size_t len);
+        bool mapFile();
+        void unmapFile();
+        void openInput();
+        size_t scanBlocks(std::string_view data, bool eof);
+        bool pump();
+        void closeInput();
+        size_t readInput(char* dst, size_t cap);
+        std::string_view readSpan(const BlockSpan& span, std::string& scratch);
+        void parseMapped();
+        void parseParallel();
+        void parseStream();
+        void parseHeaderBody(std::string_view body);
+        void parseFrameBody(std::string_view body, int start, int end, const FrameRanges& ranges, CommandList& out);
+        void parsePixels(std::string_view body, Command& cmd, CommandList& out);
+        uint32_t paletteIndexFor(uint32_t rgba);
+        void indexColors(CommandList& cmds, size_t from);
 
     public:
-        Parser(const std::string& filepath);
+        Parser(const std::string& filepath, ParseMode mode = ParseMode::Auto);
+        // Parse a buffer you already have (plain .hmic text or zstd-compressed).
+        // Nothing is copied - the bytes have to outlive the parser.
+        Parser(FromMemory, std::string_view data);
+        ~Parser();
+        Parser(const Parser&) = delete;             // owns the mapping, no copies
+        Parser& operator=(const Parser&) = delete;
+        // 🧵 >1 = parse frame blocks on that many threads (mapped files only), 0 = all cores
+        void setThreadCount(unsigned n);
         void parse();
-        std::map<std::string, std::string> getHeader() const;
-        std::vector<Command> getCommands() const;
+
+        // 🚰 PULL API - use instead of parse(), not together with it.
+        // readHeader() fills getHeader() without touching the frames, nextBlock()
+        // returns the next frame block (false at end of file). Memory stays at
+        // one block no matter how big the file is.
+        bool readHeader();
+        bool nextBlock(FrameBlock& out);
+
+        // 🗂️ RANDOM ACCESS - buildIndex() does one brace-depth-only pass over the
+        // file. parseFramesInRange(a, b) loads the .hmicidx sidecar (building and
+        // saving it first if missing/stale), then parses ONLY the header and the
+        // blocks that overlap frames a..b. getCommands() has just those afterwards.
+        BlockIndex buildIndex();
+        const BlockIndex& loadOrBuildIndex();
+        void parseFramesInRange(int a, int b);
+        bool isMapped() const { return mapped != nullptr; }
+        // zstd input? Known right away for regular files, for pipes only once
+        // parsing has started (their first bytes can't be read twice)
+        bool isCompressed() const { return compressed; }
+        // No copies: getCommands() is a view that lives as long as the parser (and
+        // until the next parse call); takeCommands() moves the whole arena out.
+        const std::map<std::string, std::string>& getHeader() const { return header; }
+        const CommandList& getCommands() const { return commands; }
+        CommandList takeCommands() { return std::move(commands); }
+        const std::vector<uint32_t>& getPalette() const { return palette; }
+        const ParseStats& getStats() const { return stats; }
     };
 
+    // 🏎️ SIMD TOKEN SCANNING (hmicx_simd.cpp) - brace/newline search kernels,
+    // best one picked at startup (AVX2 > SSE4.2 > scalar). setSimdLevel() is
+    // for benchmarks/debugging; it clamps to what the CPU has and returns that.
+    enum class SimdLevel { Scalar, SSE42, AVX2 };
+    SimdLevel simdLevel();
+    SimdLevel setSimdLevel(SimdLevel level);
+    const char* simdLevelName(SimdLevel level);
+
+    namespace detail {
+        extern const char* (*findBraceFn)(const char*, const char*);
+        extern const char* (*findNewlineFn)(const char*, const char*);
+    }
+
+    // First '{' or '}' in [p, end), or end
+    inline const char* findBrace(const char* p, const char* end) { return detail::findBraceFn(p, end); }
+    // First '\n' in [p, end), or end
+    inline const char* findNewline(const char* p, const char* end) { return detail::findNewlineFn(p, end); }
+
+    // C-locale isspace without the function call
+    inline bool isSpaceC(char c) {
+        return c == ' ' || static_cast<unsigned char>(c - '\t') < 5;
+    }
+
     // ⚡ INLINE HELPER FUNCTIONS - ZERO-COPY OPTIMIZATION GO BRRRR ⚡
     // These are inline so they get embedded at call sites for MAXIMUM SPEED 🏎️
     // Defined in header = no duplicate symbol errors + compiler can optimize better
@@ -67,15 +478,13 @@ namespace HMICX {
         return found ? num : -1;
     }
 
-    // Find matching closing brace with single scan
+    // Find matching closing brace, jumping brace to brace with the SIMD kernel
     inline size_t findMatchingBrace(const char* s, size_t len, size_t start) {
         int depth = 0;
-        for (size_t i = start; i < len; i++) {
-            if (s[i] == '{') depth++;
-            else if (s[i] == '}') {
-                depth--;
-                if (depth == 0) return i;
-            }
+        const char* end = s + len;
+        for (const char* p = findBrace(s + start, end); p < end; p = findBrace(p + 1, end)) {
+            if (*p == '{') depth++;
+            else if (--depth == 0) return p - s;
         }
         return std::string::npos;
     }
@@ -83,8 +492,8 @@ namespace HMICX {
     // Trim whitespace without creating new strings
     inline std::pair<const char*, size_t> fastTrim(const char* start, size_t len) {
         const char* end = start + len;
-        while (start < end && std::isspace(static_cast<unsigned char>(*start))) start++;
-        while (start < end && std::isspace(static_cast<unsigned char>(*(end - 1)))) end--;
+        while (start < end && isSpaceC(*start)) start++;
+        while (start < end && isSpaceC(*(end - 1))) end--;
         return {start, static_cast<size_t>(end - start)};
     }
 
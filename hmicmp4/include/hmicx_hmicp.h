@@ -0,0 +1,134 @@
+#pragma once
+#include "hmicx.h"
+#include <zstd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+// 📼 HMICP READING (header-only, needs zstd but not the library) - shared by
+// the SDL viewer and the headless renderer.
+
+namespace HMICX {
+
+    // 📼 HMICP FRAME READER - pulls ONE frame at a time out of a .hmicp, or out of
+    // a .hmicp7 through a ZSTD_DStream (no temp file, no whole-file buffer). Which
+    // one it is comes from the magic bytes. Frames are cheapest in order; going
+    // backwards in a .hmicp7 restarts the stream (that's what a loop does).
+    class HMICPReader {
+    private:
+        std::string path;
+        std::ifstream file;
+        bool compressed = false;
+        // owned from the moment it exists - the constructor can still throw after
+        std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> ds{nullptr, &ZSTD_freeDStream};
+        std::vector<char> inBuf;
+        ZSTD_inBuffer in{nullptr, 0, 0};
+        uint32_t nextFrame = 0;
+        size_t frameBytes = 0;
+
+        // exactly n bytes of (decompressed) content, or throw
+        void readExact(char* dst, size_t n) {
+            if (!compressed) {
+                if (!file.read(dst, n)) throw std::runtime_error("Truncated HMICP file: " + path);
+                return;
+            }
+            ZSTD_outBuffer out{dst, n, 0};
+            while (out.pos < out.size) {
+                if (in.pos == in.size) {
+                    file.read(inBuf.data(), inBuf.size());
+                    in = {inBuf.data(), size_t(file.gcount()), 0};
+                    if (in.size == 0) throw std::runtime_error("Truncated HMICP7 stream: " + path);
+                }
+                size_t ret = ZSTD_decompressStream(ds.get(), &out, &in);
+                if (ZSTD_isError(ret)) {
+                    throw std::runtime_error(std::string("Zstd decompression failed: ") + ZSTD_getErrorName(ret));
+                }
+            }
+        }
+
+        // back to byte 0 and past the header
+        void rewind() {
+            file.clear();
+            file.seekg(0);
+            if (compressed) {
+                ZSTD_initDStream(ds.get());
+                in = {inBuf.data(), 0, 0};
+            }
+            HMICPHeader skip;
+            readExact(reinterpret_cast<char*>(&skip), sizeof(skip));
+            nextFrame = 0;
+        }
+
+    public:
+        HMICPHeader header;
+
+        // the [DEBUG] header dump goes to `log` (nullptr = quiet, e.g. when stdout
+        // carries the pixels)
+        explicit HMICPReader(const std::string& path, std::ostream* log = &std::cout) : path(path) {
+            file.open(path, std::ios::binary);
+            if (!file.is_open()) throw std::runtime_error("Failed to open HMICP file: " + path);
+
+            unsigned char magic[4] = {0};
+            file.read(reinterpret_cast<char*>(magic), 4);
+            compressed = file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD;
+            if (compressed) {
+                ds.reset(ZSTD_createDStream());
+                if (!ds) throw std::runtime_error("Cannot create ZSTD_DStream");
+                inBuf.resize(ZSTD_DStreamInSize());
+                if (log) *log << "[DEBUG] 🌀 Compressed HMICP7 - decompressing frames on the fly" << std::endl;
+            }
+
+            file.clear();
+            file.seekg(0);
+            if (compressed) ZSTD_initDStream(ds.get());
+            readExact(reinterpret_cast<char*>(&header), sizeof(header));
+
+            // Verify magic
+            if (std::strncmp(header.magic, "HMICP", 5) != 0) {
+                throw std::runtime_error("Invalid HMICP file - magic header mismatch!");
+            }
+
+            frameBytes = size_t(header.width) * header.height * 4;
+            if (!log) return;
+            *log << "[DEBUG] ✅ Valid HMICP file detected!" << std::endl;
+            *log << "[DEBUG] 📊 Version: " << (int)header.version << std::endl;
+            *log << "[DEBUG] 📊 Dimensions: " << header.width << "x" << header.height << std::endl;
+            *log << "[DEBUG] 📊 FPS: " << header.fps << std::endl;
+            *log << "[DEBUG] 📊 Frames: " << header.totalFrames << std::endl;
+            *log << "[DEBUG] 📊 Loop: " << (header.loop ? "YES" : "NO") << std::endl;
+            *log << "[DEBUG] 💾 Bytes per frame: " << frameBytes << std::endl;
+        }
+
+        HMICPReader(const HMICPReader&) = delete;
+        HMICPReader& operator=(const HMICPReader&) = delete;
+
+        size_t bytesPerFrame() const { return frameBytes; }
+
+        // frame f (0-based) → dst (bytesPerFrame() bytes)
+        void read(uint32_t f, char* dst) {
+            if (f != nextFrame) {
+                if (!compressed) {
+                    file.clear();
+                    file.seekg(sizeof(HMICPHeader) + uint64_t(f) * frameBytes);
+                    nextFrame = f;
+                } else {
+                    if (f < nextFrame) rewind();
+                    while (nextFrame < f) {  // zstd can't seek: decode and throw away
+                        readExact(dst, frameBytes);
+                        nextFrame++;
+                    }
+                }
+            }
+            readExact(dst, frameBytes);
+            nextFrame = f + 1;
+            if (f == 0 || (f + 1) % 30 == 0 || f == header.totalFrames - 1) {
+                HMICX_LOG(HMICX_LVL_BLOCK, "📥 Loaded frame " << (f + 1) << "/" << header.totalFrames);
+            }
+        }
+    };
+}
@@ -0,0 +1,361 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <ostream>
+
+// 🎞️ PLAYBACK PLUMBING (header-only, no library needed) - a producer thread
+// builds frames AHEAD of the SDL thread into a small ring of RGBA buffers, so a
+// frame that's slow to decode/rasterize doesn't stall the display. The two
+// threads only talk through the lock-free single-producer/single-consumer ring.
+
+namespace HMICX {
+
+    // 🔁 SPSC RING - fixed slots, preallocated, never resized. head/tail only
+    // ever grow; head - tail = how many slots are filled. The producer owns head,
+    // the consumer owns tail, each only reads the other's with acquire.
+    template <typename T>
+    class SpscRing {
+    private:
+        std::vector<T> slots;
+        alignas(64) std::atomic<size_t> head{0};  // next slot to write
+        alignas(64) std::atomic<size_t> tail{0};  // next slot to read
+
+    public:
+        explicit SpscRing(size_t capacity) : slots(std::max<size_t>(capacity, 1)) {}
+
+        size_t capacity() const { return slots.size(); }
+        size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+        T& slot(size_t i) { return slots[i]; }  // for preallocating, before any thread starts
+
+        // producer: free slot to fill, nullptr = full
+        T* beginWrite() {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) == slots.size()) return nullptr;
+            return &slots[h % slots.size()];
+        }
+        void commitWrite() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        // consumer: oldest filled slot, nullptr = empty
+        T* front() {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire)) return nullptr;
+            return &slots[t % slots.size()];
+        }
+        void pop() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    };
+
+    // 🖼️ One prebuilt frame. rowFirst..rowLast = rows that differ from the frame
+    // produced just before it (seq - 1), so the consumer can upload only that
+    // band when it shows frames back to back. Starts as "every row" (rowLast =
+    // INT_MAX, clamp it to the height); empty (rowLast < rowFirst) = identical.
+    // The consumer never writes a slot, so when produce() gets one its pixels
+    // still hold the frame produced for heldSeq (0 = never filled, all zeros).
+    struct FrameSlot {
+        int frame = 0;            // 0-based
+        uint64_t seq = 0;         // production order, 1, 2, 3...
+        uint64_t heldSeq = 0;     // seq the pixels are left over from (set before produce())
+        uint32_t generation = 0;  // bumped by seek(); stale slots are skipped
+        int rowFirst = 0, rowLast = -1;
+        std::vector<uint32_t> pixels;
+    };
+
+    // ⚙️ lookahead = how many frames to build ahead, memoryCapMB = hard ceiling
+    // on the ring (depth gets cut to fit, never below 1 frame).
+    // Env overrides: HMIC_LOOKAHEAD, HMIC_CACHE_MB.
+    struct PlaybackConfig {
+        int lookahead = 8;
+        size_t memoryCapMB = 256;
+
+        static PlaybackConfig fromEnv() {
+            PlaybackConfig c;
+            if (const char* v = std::getenv("HMIC_LOOKAHEAD")) c.lookahead = std::max(1, std::atoi(v));
+            if (const char* v = std::getenv("HMIC_CACHE_MB")) c.memoryCapMB = std::max(1, std::atoi(v));
+            return c;
+        }
+
+        size_t depthFor(size_t framePixels) const {
+            size_t frameBytes = std::max<size_t>(framePixels * sizeof(uint32_t), 1);
+            size_t fits = (memoryCapMB << 20) / frameBytes;
+            return std::max<size_t>(1, std::min<size_t>(size_t(lookahead), fits));
+        }
+    };
+
+    // 🧵 FRAME PREFETCHER - runs produce(frame, slot) on its own thread for
+    // frames 0, 1, 2... (wrapping if loop) as long as the ring has room. The
+    // consumer (SDL thread) calls front()/pop() and never waits on the producer:
+    // front() == nullptr just means "not ready yet, keep the last frame up".
+    // With the ring full (or a non-looping clip done) the producer sleeps on a
+    // condition variable until pop()/seek()/stop() gives it something to do.
+    // The other way round, ready() (optional, producer thread) fires when a frame
+    // lands in an EMPTY ring or production fails - the viewers turn it into an
+    // SDL event, so a consumer that ran dry can block instead of polling.
+    //
+    // produce() fills slot.pixels (already sized) and, optionally, the changed
+    // row band; it runs ONLY on the producer thread, so whatever state it keeps
+    // (a compositor, a zstd stream...) needs no locking. Exceptions thrown in
+    // it come back out of front() on the consumer thread.
+    class FramePrefetcher {
+    public:
+        using Produce = std::function<void(int frame, FrameSlot& slot)>;
+        using Ready = std::function<void()>;
+
+        FramePrefetcher(int totalFrames, bool loop, size_t framePixels, const PlaybackConfig& cfg, Produce produce,
+                        Ready ready = nullptr)
+            : ring(cfg.depthFor(framePixels)), total(std::max(totalFrames, 1)), loop(loop),
+              produce(std::move(produce)), ready(std::move(ready)) {
+            for (size_t i = 0; i < ring.capacity(); i++) {
+                ring.slot(i).pixels.resize(framePixels);
+            }
+            worker = std::thread([this] { run(); });
+        }
+
+        ~FramePrefetcher() { stop(); }
+
+        // Stop and join the producer (whatever produce() touches is safe to read after)
+        void stop() {
+            stopping.store(true, std::memory_order_release);
+            wakeProducer();
+            if (worker.joinable()) worker.join();
+        }
+
+        FramePrefetcher(const FramePrefetcher&) = delete;
+        FramePrefetcher& operator=(const FramePrefetcher&) = delete;
+
+        size_t depth() const { return ring.capacity(); }
+        size_t buffered() const { return ring.size(); }
+
+        // Next ready frame, or nullptr. Slots from before the last seek() are dropped here.
+        const FrameSlot* front() {
+            if (failed.load(std::memory_order_acquire)) std::rethrow_exception(error);
+            uint32_t gen = generation.load(std::memory_order_relaxed);
+            FrameSlot* s = ring.front();
+            bool dropped = false;
+            while (s && s->generation != gen) {
+                ring.pop();
+                dropped = true;
+                s = ring.front();
+            }
+            if (dropped) wakeProducer();  // room again
+            return s;
+        }
+        void pop() {
+            ring.pop();
+            wakeProducer();
+        }
+
+        // Consumer only: restart production at `frame` (0-based). Frames already
+        // in flight are thrown away as they come out of front().
+        void seek(int frame) {
+            seekTarget.store(frame, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            wakeProducer();
+        }
+
+        // non-looping clip: every frame produced and taken
+        bool finished() {
+            int64_t done = doneGeneration.load(std::memory_order_acquire);
+            return done == int64_t(generation.load(std::memory_order_relaxed)) && !front();
+        }
+
+    private:
+        SpscRing<FrameSlot> ring;
+        int total;
+        bool loop;
+        Produce produce;
+        Ready ready;
+        std::thread worker;
+        std::atomic<bool> stopping{false};
+        std::atomic<int64_t> doneGeneration{-1};  // generation that ran off the end (non-loop)
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::atomic<uint32_t> generation{0};
+        std::atomic<int> seekTarget{0};
+        std::mutex idleMutex;
+        std::condition_variable idle;  // producer sleeps here while there's nothing to do
+
+        // the lock makes sure a producer that just found nothing to do is
+        // either already waiting or will see the change
+        void wakeProducer() {
+            { std::lock_guard<std::mutex> lock(idleMutex); }
+            idle.notify_one();
+        }
+
+        void run() {
+            uint32_t gen = 0;
+            int next = 0;
+            uint64_t seq = 0;
+            try {
+                while (!stopping.load(std::memory_order_acquire)) {
+                    uint32_t want = generation.load(std::memory_order_acquire);
+                    if (want != gen) {
+                        gen = want;
+                        next = std::clamp(seekTarget.load(std::memory_order_relaxed), 0, total - 1);
+                    }
+                    FrameSlot* s = (next < total) ? ring.beginWrite() : nullptr;
+                    if (!s) {
+                        // full (or a finished clip): sleep until the consumer frees a slot, seeks or stops us
+                        std::unique_lock<std::mutex> lock(idleMutex);
+                        idle.wait(lock, [&] {
+                            return stopping.load(std::memory_order_acquire) ||
+                                   generation.load(std::memory_order_acquire) != gen ||
+                                   (next < total && ring.size() < ring.capacity());
+                        });
+                        continue;
+                    }
+
+                    s->frame = next;
+                    s->heldSeq = s->seq;
+                    s->seq = ++seq;
+                    s->generation = gen;
+                    s->rowFirst = 0;
+                    s->rowLast = INT_MAX;  // whole frame unless produce() narrows it
+                    produce(next, *s);
+                    ring.commitWrite();
+                    if (ready && ring.size() == 1) ready();  // the consumer may be waiting on this one
+
+                    if (++next >= total) {
+                        if (loop) next = 0;
+                        else doneGeneration.store(gen, std::memory_order_release);
+                    }
+                }
+            } catch (...) {
+                error = std::current_exception();
+                failed.store(true, std::memory_order_release);
+                if (ready) ready();  // front() has an exception to hand out
+            }
+        }
+    };
+
+    // 📊 Fixed-bucket histogram of durations (bucket i = up to edgesUs[i] µs,
+    // the last bucket catches everything bigger)
+    struct PacingHistogram {
+        static constexpr int BUCKETS = 9;
+        static constexpr int64_t edgesUs[BUCKETS - 1] = {500, 1000, 2000, 4000, 8000, 16000, 33000, 66000};
+        uint64_t counts[BUCKETS] = {0};
+        uint64_t total = 0;
+        int64_t sumUs = 0, maxUs = 0;
+
+        void add(int64_t us) {
+            int b = 0;
+            while (b < BUCKETS - 1 && us > edgesUs[b]) b++;
+            counts[b]++;
+            total++;
+            sumUs += us;
+            maxUs = std::max(maxUs, us);
+        }
+
+        void dump(std::ostream& os, const char* name) const {
+            os << "  " << name << ": " << total << " samples";
+            if (!total) {
+                os << "\n";
+                return;
+            }
+            os << ", mean " << (double(sumUs) / total / 1000.0) << "ms, max " << (maxUs / 1000.0) << "ms\n";
+            for (int b = 0; b < BUCKETS; b++) {
+                if (!counts[b]) continue;
+                char label[32];
+                if (b < BUCKETS - 1) std::snprintf(label, sizeof(label), "<=%6.1fms", edgesUs[b] / 1000.0);
+                else std::snprintf(label, sizeof(label), "> %6.1fms", edgesUs[BUCKETS - 2] / 1000.0);
+                int bar = int(40 * counts[b] / total);
+                os << "    " << label << " " << std::string(std::max(bar, 1), '#') << " " << counts[b] << "\n";
+            }
+        }
+    };
+
+    // ⏰ PLAYBACK CLOCK - frame n is due at start + n * period on steady_clock,
+    // ABSOLUTE deadlines, so time spent drawing never pushes the next frame back
+    // and a long clip doesn't drift. The SDL loop blocks in
+    // SDL_WaitEventTimeout(msUntilDue()) instead of sleeping or polling, and
+    // when it's behind it drops frames (dueTick() is past nextTick()) instead of
+    // playing them late one after another.
+    //
+    // Every presented frame records jitter (how long after its deadline it hit
+    // the screen); frames more than lateUs past it also go in the late histogram.
+    class PlaybackClock {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Stats {
+            uint64_t presented = 0;
+            uint64_t dropped = 0;
+            uint64_t stalls = 0;  // deadline passed with no frame ready
+            PacingHistogram jitter;
+            PacingHistogram late;
+        };
+
+        explicit PlaybackClock(double fps, int64_t lateUs = 2000)
+            : period(std::chrono::nanoseconds(int64_t(1e9 / (fps > 0 ? fps : 2.0)))), lateUs(lateUs) {
+            restart();
+        }
+
+        // tick 0 is due right now (start, seek, reset)
+        void restart() {
+            start = Clock::now();
+            tick = 0;
+        }
+
+        Clock::time_point deadline(uint64_t n) const { return start + period * int64_t(n); }
+        uint64_t nextTick() const { return tick; }
+        bool due() const { return Clock::now() >= deadline(tick); }
+
+        // latest tick whose deadline has passed (== nextTick() when on time)
+        uint64_t dueTick() const {
+            auto now = Clock::now();
+            if (now < start) return 0;
+            return uint64_t((now - start) / period);
+        }
+
+        // for SDL_WaitEventTimeout: whole ms until the next deadline, rounded UP
+        // so we never wake early and spin
+        int msUntilDue() const {
+            auto left = deadline(tick) - Clock::now();
+            if (left <= Clock::duration::zero()) return 0;
+            return int(std::chrono::duration_cast<std::chrono::microseconds>(left).count() / 1000 + 1);
+        }
+
+        void presented() {
+            int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - deadline(tick)).count();
+            us = std::max<int64_t>(us, 0);
+            stats.presented++;
+            stats.jitter.add(us);
+            if (us > lateUs) stats.late.add(us);
+            tick++;
+        }
+        void dropped() {
+            stats.dropped++;
+            tick++;
+        }
+        void stalled() { stats.stalls++; }
+
+        const Stats& getStats() const { return stats; }
+
+        void dump(std::ostream& os) const {
+            os << "[PACING] ⏰ " << stats.presented << " presented, " << stats.dropped << " dropped, "
+               << stats.late.total << " late (>" << (lateUs / 1000.0) << "ms), " << stats.stalls
+               << " stalls waiting on frames | period "
+               << (std::chrono::duration_cast<std::chrono::microseconds>(period).count() / 1000.0) << "ms\n";
+            stats.jitter.dump(os, "jitter");
+            stats.late.dump(os, "late");
+        }
+
+    private:
+        Clock::duration period;
+        int64_t lateUs;
+        Clock::time_point start;
+        uint64_t tick = 0;
+        Stats stats;
+    };
+}
@@ -0,0 +1,213 @@
+#pragma once
+#include "hmicx.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace HMICX {
+
+    // 🎨 How a command's color lands on what's already there
+    // Opaque = replace (alpha ignored, what the SDL viewer has always done)
+    // Over   = alpha blend, keeping the max alpha (what the HMICP converters do)
+    enum class Blend { Opaque, Over };
+
+    // Over, bit-for-bit the same float math as the converters' blendPixel()
+    inline uint32_t blendOver(uint32_t bg, uint32_t c) {
+        uint8_t a = colorA(c);
+        if (a == 255) return c;
+        if (a == 0) return bg;
+        float alpha = a / 255.0f;
+        float invAlpha = 1.0f - alpha;
+        return packRGBA((uint8_t)(colorR(c) * alpha + colorR(bg) * invAlpha),
+                        (uint8_t)(colorG(c) * alpha + colorG(bg) * invAlpha),
+                        (uint8_t)(colorB(c) * alpha + colorB(bg) * invAlpha),
+                        std::max(colorA(bg), a));
+    }
+
+    // 📐 Allocator for cache-line aligned storage (std::vector only promises
+    // alignof(T), i.e. 16 bytes from malloc)
+    template <typename T, std::size_t Align = 64>
+    struct AlignedAllocator {
+        using value_type = T;
+        template <typename U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+        AlignedAllocator() = default;
+        template <typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+        T* allocate(std::size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align))); }
+        void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(Align)); }
+
+        template <typename U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+        template <typename U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+    };
+
+    // 🖼️ FRAMEBUFFER - one uint32_t per pixel, 0xRRGGBBAA (same packing as
+    // Command::rgba, and what SDL_PIXELFORMAT_RGBA8888 expects). Commands are
+    // drawn into it on the CPU, row by row, then the whole thing goes to the GPU
+    // in ONE upload instead of one renderer call per pixel.
+    //
+    // Coordinates are HMIC coordinates: 1-based, runs inclusive on both ends.
+    // Anything outside the image is clipped, never written. The pixels start on
+    // a 64-byte boundary.
+    class Framebuffer {
+    private:
+        int w = 0, h = 0;
+        std::vector<uint32_t, AlignedAllocator<uint32_t>> pixels;
+
+    public:
+        Framebuffer() = default;
+        Framebuffer(int width, int height) { resize(width, height); }
+
+        void resize(int width, int height);
+        int width() const { return w; }
+        int height() const { return h; }
+        int pitch() const { return w * 4; }  // bytes per row, for SDL_UpdateTexture
+        uint32_t* data() { return pixels.data(); }
+        const uint32_t* data() const { return pixels.data(); }
+        uint32_t* row(int y) { return pixels.data() + size_t(y) * w; }  // 0-based row
+        const uint32_t* row(int y) const { return pixels.data() + size_t(y) * w; }
+
+        void clear(uint32_t color) { std::fill(pixels.begin(), pixels.end(), color); }
+
+        // ➡️ x0..x1 on row y, one fill per row - this is the hot loop
+        void fillRun(int x0, int x1, int y, uint32_t color, Blend blend = Blend::Opaque) {
+            if (y < 1 || y > h) return;
+            x0 = std::max(x0, 1);
+            x1 = std::min(x1, w);
+            if (x0 > x1) return;
+            uint32_t* p = row(y - 1) + (x0 - 1);
+            if (blend == Blend::Opaque || colorA(color) == 255) {
+                std::fill_n(p, x1 - x0 + 1, color);
+            } else if (colorA(color) > 0) {
+                for (int x = x0; x <= x1; x++, p++) *p = blendOver(*p, color);
+            }
+        }
+
+        void plot(int x, int y, uint32_t color, Blend blend = Blend::Opaque) {
+            if (x < 1 || x > w || y < 1 || y > h) return;
+            uint32_t& p = row(y - 1)[x - 1];
+            p = blend == Blend::Opaque ? color : blendOver(p, color);
+        }
+
+        // All of a command's runs and singles in one color. Returns pixels written.
+        size_t draw(Span<Run> runs, Span<Pixel> singles, uint32_t color, Blend blend = Blend::Opaque);
+    };
+
+    // Opaque framebuffer color for a command: the viewer has always ignored alpha
+    inline uint32_t opaque(uint32_t rgba) { return rgba | 0xFFu; }
+
+    // 🎬 Clear to `background` and draw every command on frame f, in file order
+    // (later commands win). Returns pixels written.
+    size_t rasterizeFrame(Framebuffer& fb, const CommandList& cmds, int frame,
+                          uint32_t background = 0x000000FFu);
+
+    // ⏱️ Same, but only visits index.active() (the frame the index is on)
+    size_t rasterizeFrame(Framebuffer& fb, const CommandList& cmds, const FrameIndex& index,
+                          uint32_t background = 0x000000FFu);
+
+    // 🧵 BANDED RASTERIZER - for big stills where one thread filling millions of
+    // runs is the bottleneck. At construction every command's runs and singles
+    // are bucketed by horizontal band (whole rows, a multiple of 16 so each band
+    // starts on a 64-byte line of the framebuffer); at draw time each thread
+    // claims a band, clears it and draws its pieces in FILE order. Bands never
+    // share rows, so there are no locks and overlapping draws inside a band
+    // land exactly like the serial path. There are a few bands per thread so
+    // one busy strip doesn't hold everybody up. The helper threads are started
+    // once, here, and sleep between draws (a loop wrap doesn't spawn threads).
+    // Costs a second copy of the runs. The CommandList must outlive it.
+    class BandedRasterizer {
+    public:
+        // threads = 0: all cores. Small images get fewer bands (and threads).
+        BandedRasterizer(const CommandList& cmds, int width, int height, unsigned threads = 0,
+                         Blend blend = Blend::Opaque);
+        ~BandedRasterizer();
+
+        BandedRasterizer(const BandedRasterizer&) = delete;
+        BandedRasterizer& operator=(const BandedRasterizer&) = delete;
+
+        // Same results as rasterizeFrame(), frame number or FrameIndex flavor
+        size_t rasterize(Framebuffer& fb, int frame, uint32_t background = 0x000000FFu) const;
+        size_t rasterize(Framebuffer& fb, const FrameIndex& index, uint32_t background = 0x000000FFu) const;
+
+        unsigned threadCount() const { return threads; }
+        size_t bandCount() const { return bands.size(); }
+
+    private:
+        // one command's share of a band: a slice of the band's own runs/singles
+        struct Piece {
+            uint32_t command;
+            uint32_t runOffset, runCount;
+            uint32_t singleOffset, singleCount;
+        };
+        struct Band {
+            int y0 = 1, y1 = 0;  // 1-based rows, inclusive
+            std::vector<Piece> pieces;
+            std::vector<Run> runs;
+            std::vector<Pixel> singles;
+        };
+
+        const CommandList& cmds;
+        int w, h;
+        unsigned threads;
+        Blend blend;
+        std::vector<Band> bands;
+
+        struct Crew;  // the threads - 1 persistent helpers (hmicx_raster.cpp)
+        std::unique_ptr<Crew> crew;
+
+        template <typename Active>
+        size_t drawBands(Framebuffer& fb, uint32_t background, const Active& active) const;
+    };
+
+    // 🧩 INCREMENTAL COMPOSITOR - keeps the last frame around and, going from
+    // frame f to f + 1, only repaints the ROWS touched by commands that ended or
+    // started (cleared to background, then every active command that reaches
+    // them is redrawn on just those rows, in file order - so the result is
+    // exactly a full redraw). A frame where nothing starts or ends costs nothing.
+    // Anything that isn't "the next frame" (first frame, loop, seek) is a full
+    // redraw, and with setThreadCount() > 1 full redraws go through a
+    // BandedRasterizer. The CommandList must outlive the compositor.
+    class Compositor {
+    public:
+        // [first, last] 0-based rows that changed, empty() = framebuffer untouched
+        struct Rows {
+            int first = 0, last = -1;
+            bool empty() const { return last < first; }
+            int count() const { return empty() ? 0 : last - first + 1; }
+        };
+
+        struct Stats {
+            uint64_t fullRedraws = 0;
+            uint64_t incremental = 0;    // frames that repainted some rows
+            uint64_t unchanged = 0;      // frames that touched nothing
+            uint64_t rowsRepainted = 0;  // summed over incremental frames
+        };
+
+        Compositor(const CommandList& cmds, int width, int height,
+                   Blend blend = Blend::Opaque, uint32_t background = 0x000000FFu);
+
+        Rows render(int frame);
+        Rows redraw(int frame);  // force the full path
+        void setThreadCount(unsigned n);  // full redraws on n threads, 0 = all cores
+        const Framebuffer& framebuffer() const { return fb; }
+        int frame() const { return index.frame(); }
+        const Stats& getStats() const { return stats; }
+
+    private:
+        const CommandList& cmds;
+        FrameIndex index;
+        Framebuffer fb;
+        Blend blend;
+        uint32_t background;
+        bool valid = false;
+        std::vector<uint32_t> prev, changed;
+        std::vector<uint8_t> dirty;           // one flag per row
+        std::vector<std::pair<int, int>> ys;  // per command: 1-based min/max row it touches
+        Stats stats;
+        std::unique_ptr<BandedRasterizer> banded;  // only with setThreadCount() > 1
+
+        uint32_t colorOf(const Command& c) const { return blend == Blend::Opaque ? opaque(c.rgba) : c.rgba; }
+    };
+}
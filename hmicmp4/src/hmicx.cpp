@@ -1,9 +1,18 @@
 #include "hmicx.h"
+#include <zstd.h>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <cctype>
 #include <cstring>
+#include <thread>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace HMICX;
@@ -11,106 +20,63 @@ using namespace HMICX;
 // 🔥 STREAMING BUFFER SIZE - ADJUST THIS BASED ON YOUR VIBE
 constexpr size_t BUFFER_SIZE = 8192; // 8KB chunks = chef's kiss 👨‍🍳
 
-Parser::Parser(const string& filepath) {
-    this->filepath = filepath;
-    cout << "[DEBUG] 🔥 Streaming Parser constructor called with: " << filepath << endl;
-    
-    // Just check if file exists, don't load it yet!
-    ifstream test(filepath);
-    if (!test.is_open()) throw runtime_error("Cannot open file: " + filepath);
-    test.close();
-    
-    cout << "[DEBUG] ✅ File exists and is readable! Ready to stream 🌊" << endl;
+// Read up to `count` comma-separated decimal components, like sscanf's %d,%d,...
+// (leading spaces before each number are fine, anything else stops the read)
+static int readComponents(string_view s, size_t pos, int* out, int count) {
+    int got = 0;
+    while (got < count) {
+        while (pos < s.size() && isspace(static_cast<unsigned char>(s[pos]))) pos++;
+        bool neg = false;
+        if (pos < s.size() && (s[pos] == '-' || s[pos] == '+')) neg = (s[pos++] == '-');
+        if (pos >= s.size() || !isdigit(static_cast<unsigned char>(s[pos]))) break;
+        int v = 0;
+        while (pos < s.size() && isdigit(static_cast<unsigned char>(s[pos]))) v = v * 10 + (s[pos++] - '0');
+        out[got++] = neg ? -v : v;
+        if (got < count) {
+            if (pos >= s.size() || s[pos] != ',') break;
+            pos++;
+        }
+    }
+    return got;
 }
 
-void Parser::parse() {
-    cout << "[DEBUG] 🚀 Starting streaming parse()..." << endl;
-    parseHeader();
-    parseFrames();
-    cout << "[DEBUG] ✅ Streaming parse complete!" << endl;
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    return (tolower(static_cast<unsigned char>(c)) - 'a') + 10;
 }
 
-void Parser::parseHeader() {
-    cout << "[DEBUG] 📋 Starting streaming parseHeader()..." << endl;
-    
-    ifstream file(filepath);
-    if (!file.is_open()) throw runtime_error("Cannot open file");
-    
-    string buffer;
-    buffer.reserve(BUFFER_SIZE);
-    string accumulator; // For handling tokens that span chunks
+uint32_t HMICX::decodeColor(string_view s) {
+    int c[4] = {255, 255, 255, 255};
     
-    bool foundInfo = false;
-    int braceDepth = 0;
-    string headerContent;
-    
-    while (file) {
-        buffer.resize(BUFFER_SIZE);
-        file.read(&buffer[0], BUFFER_SIZE);
-        streamsize bytesRead = file.gcount();
-        buffer.resize(bytesRead);
-        
-        // Append to accumulator to handle spanning
-        accumulator += buffer;
-        
-        // Look for "info {" block
-        for (size_t i = 0; i < accumulator.size(); i++) {
-            if (!foundInfo) {
-                if (i + 4 <= accumulator.size() && 
-                    fastStartsWith(accumulator.c_str() + i, accumulator.size() - i, "info", 4)) {
-                    cout << "[DEBUG] 🔍 Found 'info' keyword!" << endl;
-                    
-                    // Skip to opening brace
-                    size_t j = i + 4;
-                    while (j < accumulator.size() && isspace(accumulator[j])) j++;
-                    
-                    if (j < accumulator.size() && accumulator[j] == '{') {
-                        foundInfo = true;
-                        braceDepth = 1;
-                        i = j;
-                        cout << "[DEBUG] 📦 Found opening brace!" << endl;
-                        continue;
-                    }
-                }
-            } else {
-                // We're inside the info block, collect content
-                if (accumulator[i] == '{') braceDepth++;
-                else if (accumulator[i] == '}') {
-                    braceDepth--;
-                    if (braceDepth == 0) {
-                        // Done! Parse the header content
-                        cout << "[DEBUG] ✅ Found closing brace! Header length: " << headerContent.size() << endl;
-                        parseHeaderBody(headerContent.c_str(), headerContent.size());
-                        file.close();
-                        return;
-                    }
-                }
-                
-                if (braceDepth > 0) {
-                    headerContent += accumulator[i];
-                }
-            }
-        }
-        
-        // Keep last bit in case token spans chunks
-        if (accumulator.size() > 100 && !foundInfo) {
-            accumulator = accumulator.substr(accumulator.size() - 100);
-        }
+    if (s.size() == 7 && s[0] == '#') {
+        for (int i = 0; i < 3; i++) c[i] = hexDigit(s[1 + i * 2]) * 16 + hexDigit(s[2 + i * 2]);
+    } else if (fastStartsWith(s.data(), s.size(), "rgba(", 5)) {
+        int v[4];
+        if (readComponents(s, 5, v, 4) == 4) memcpy(c, v, sizeof(v));
+    } else if (fastStartsWith(s.data(), s.size(), "rgb(", 4)) {
+        int v[3];
+        if (readComponents(s, 4, v, 3) == 3) memcpy(c, v, sizeof(v));
     }
     
-    file.close();
-    cout << "[DEBUG] ⚠️ No complete header found in file!" << endl;
+    return packRGBA(uint8_t(c[0]), uint8_t(c[1]), uint8_t(c[2]), uint8_t(c[3]));
 }
 
-void Parser::parseHeaderBody(const char* body, size_t len) {
-    cout << "[DEBUG] 📝 Parsing header body (length: " << len << ")" << endl;
-    
+// 🌀 zstd frame magic (0xFD2FB528, little-endian)
+static bool isZstd(const char* p, size_t n) {
+    return n >= 4 && (unsigned char)p[0] == 0x28 && (unsigned char)p[1] == 0xB5 &&
+           (unsigned char)p[2] == 0x2F && (unsigned char)p[3] == 0xFD;
+}
+
+// 📋 KEY=VALUE lines of an info{} body → header map (keys uppercased).
+// Shared by the parser and probe(). Returns how many lines it took.
+static int parseHeaderLines(string_view body, map<string, string>& header) {
+    size_t len = body.size();
     size_t lineStart = 0;
     int lines_parsed = 0;
     
     for (size_t i = 0; i <= len; i++) {
         if (i == len || body[i] == '\n') {
-            auto [linePtr, lineLen] = fastTrim(body + lineStart, i - lineStart);
+            auto [linePtr, lineLen] = fastTrim(body.data() + lineStart, i - lineStart);
             
             if (lineLen > 0) {
                 const char* eq = (const char*)memchr(linePtr, '=', lineLen);
@@ -125,147 +91,699 @@ void Parser::parseHeaderBody(const char* body, size_t len) {
                         string val(valPtr, valLen);
                         header[key] = val;
                         lines_parsed++;
-                        cout << "[DEBUG]   📌 " << key << " = " << val << endl;
+                        HMICX_LOG(HMICX_LVL_TRACE, "  📌 " << key << " = " << val);
                     }
                 }
             }
             lineStart = i + 1;
         }
     }
+    return lines_parsed;
+}
+
+struct Parser::ZstdState {
+    ZSTD_DStream* ds = nullptr;
+    vector<char> inBuf;         // compressed chunk from the file
+    ZSTD_inBuffer in{nullptr, 0, 0};
+    size_t lastRet = 0;         // 0 = sitting on a frame boundary
+    
+    ZstdState() {
+        ds = ZSTD_createDStream();
+        if (!ds) throw runtime_error("Cannot create ZSTD_DStream");
+        ZSTD_initDStream(ds);
+    }
+    ~ZstdState() { ZSTD_freeDStream(ds); }
+};
+
+Parser::Parser(const string& filepath, ParseMode mode) {
+    this->filepath = filepath;
+    this->mode = mode;
+    HMICX_LOG(HMICX_LVL_INFO, "🔥 Streaming Parser constructor called with: " << filepath);
+    
+    // Just check if file exists, don't load it yet!
+    struct stat st;
+    if (stat(filepath.c_str(), &st) != 0 || access(filepath.c_str(), R_OK) != 0) {
+        throw runtime_error("Cannot open file: " + filepath);
+    }
     
-    cout << "[DEBUG] 📊 Parsed " << lines_parsed << " header lines" << endl;
+    // 🔎 Sniff the zstd magic now ONLY for regular files. A pipe/FIFO/stdin can
+    // be read once (and a FIFO's writer dies if we open and close it), so it
+    // isn't touched here - openInput() decides from the first bytes it reads.
+    if (S_ISREG(st.st_mode)) {
+        ifstream test(filepath, ios::binary);
+        if (!test.is_open()) throw runtime_error("Cannot open file: " + filepath);
+        char magic[4];
+        test.read(magic, 4);
+        compressed = isZstd(magic, test.gcount());
+        sniffed = true;
+    }
+    
+    HMICX_LOG(HMICX_LVL_INFO, "✅ File exists and is readable! Ready to stream 🌊"
+              << (compressed ? " (zstd, decompressing on the fly)" : ""));
+}
+
+Parser::Parser(FromMemory, string_view data) {
+    mode = ParseMode::Auto;
+    sniffed = true;
+    if (isZstd(data.data(), data.size())) {
+        compressed = true;
+        compressedMemory = data;
+    } else {
+        // plain text in memory is treated exactly like a mapping we don't own
+        mapped = data.data();
+        mappedSize = data.size();
+        ownsMapping = false;
+    }
+    HMICX_LOG(HMICX_LVL_INFO, "🧠 Parsing " << data.size() << " bytes from memory"
+              << (compressed ? " (zstd)" : ""));
 }
 
-void Parser::parseFrames() {
-    cout << "[DEBUG] 🎬 Starting streaming parseFrames()..." << endl;
+Parser::~Parser() {
+    unmapFile();
+}
+
+// 🗺️ Map the whole file read-only. Returns false for anything that isn't a
+// regular file (pipes, FIFOs, /dev/stdin...) so the caller can stream instead.
+bool Parser::mapFile() {
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
     
-    ifstream file(filepath);
-    if (!file.is_open()) throw runtime_error("Cannot open file");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
     
-    commands.reserve(1000);
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // mapping stays valid after close
+    if (p == MAP_FAILED) return false;
     
-    string buffer;
-    buffer.reserve(BUFFER_SIZE);
-    string accumulator;
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    mapped = static_cast<const char*>(p);
+    mappedSize = st.st_size;
+    ownsMapping = true;
+    HMICX_LOG(HMICX_LVL_INFO, "🗺️ Mapped " << mappedSize << " bytes - zero-copy mode ON");
+    return true;
+}
+
+void Parser::unmapFile() {
+    if (mapped && ownsMapping) munmap(const_cast<char*>(mapped), mappedSize);
+    mapped = nullptr;
+    mappedSize = 0;
+    ownsMapping = false;
+}
+
+void Parser::setThreadCount(unsigned n) {
+    threadCount = n ? n : max(1u, thread::hardware_concurrency());
+}
+
+// Pick the byte source once: mapping if we can (and are allowed), else the stream
+void Parser::openInput() {
+    if (inputOpen) return;
     
-    int frames_found = 0;
+    if (compressed) {
+        if (mode == ParseMode::Mmap) throw runtime_error("Cannot mmap a zstd-compressed file: " + filepath);
+        zstd = make_unique<ZstdState>();
+        if (compressedMemory.empty()) {
+            stream.open(filepath, ios::binary);
+            if (!stream.is_open()) throw runtime_error("Cannot open file: " + filepath);
+            zstd->inBuf.resize(ZSTD_DStreamInSize());
+        } else {
+            zstd->in = {compressedMemory.data(), compressedMemory.size(), 0};
+        }
+        window.reserve(BUFFER_SIZE * 2);
+        inputEof = false;
+        inputOpen = true;
+        return;
+    }
     
-    // State machine for frame parsing
-    enum State { LOOKING_FOR_FRAME, IN_FRAME };
-    State state = LOOKING_FOR_FRAME;
+    if (mode != ParseMode::Stream && (mapped || mapFile())) {
+        inputOpen = true;
+        HMICX_STAT(stats.bytesRead += mappedSize;)
+        return;
+    }
+    if (mode == ParseMode::Mmap) throw runtime_error("Cannot mmap file: " + filepath);
     
-    int frameStart = 0, frameEnd = 0;
-    int braceDepth = 0;
-    string frameContent;
+    stream.open(filepath, ios::binary);
+    if (!stream.is_open()) throw runtime_error("Cannot open file");
+    window.reserve(BUFFER_SIZE * 2);
+    inputEof = false;
+    inputOpen = true;
     
-    while (file) {
-        buffer.resize(BUFFER_SIZE);
-        file.read(&buffer[0], BUFFER_SIZE);
-        streamsize bytesRead = file.gcount();
-        buffer.resize(bytesRead);
-        
-        accumulator += buffer;
-        
-        size_t processedUntil = 0;
-        
-        for (size_t i = 0; i < accumulator.size(); i++) {
-            if (state == LOOKING_FOR_FRAME) {
-                // Look for F1234 or F1-10 pattern
-                if ((accumulator[i] == 'F' || accumulator[i] == 'f') && 
-                    i + 1 < accumulator.size() && isdigit(accumulator[i + 1])) {
-                    
-                    cout << "[DEBUG] 🎯 Found frame marker at offset!" << endl;
-                    
-                    size_t pos = i + 1;
-                    frameStart = fastExtractNumber(accumulator.c_str(), accumulator.size(), pos);
-                    frameEnd = frameStart;
+    // 🌀 Not a regular file: the first bytes say raw text or zstd. Either way
+    // they're kept - as the start of the window, or as the DStream's first input.
+    if (!sniffed) {
+        char head[4];
+        stream.read(head, sizeof(head));
+        size_t got = stream.gcount();
+        HMICX_STAT(stats.bytesRead += got;)
+        compressed = isZstd(head, got);
+        sniffed = true;
+        if (compressed) {
+            HMICX_LOG(HMICX_LVL_INFO, "🌀 zstd on a pipe, decompressing on the fly");
+            zstd = make_unique<ZstdState>();
+            zstd->inBuf.resize(ZSTD_DStreamInSize());
+            memcpy(zstd->inBuf.data(), head, got);
+            zstd->in = {zstd->inBuf.data(), got, 0};
+        } else {
+            window.append(head, got);
+        }
+    }
+}
+
+void Parser::parse() {
+    HMICX_STAT(uint64_t t0 = statClockNs();)
+    scan = ScanState{};
+    openInput();
+    
+    if (mapped) {
+        HMICX_LOG(HMICX_LVL_INFO, "🚀 Starting mapped parse()...");
+        if (threadCount > 1) parseParallel();
+        else parseMapped();
+        HMICX_LOG(HMICX_LVL_INFO, "✅ Mapped parse complete!");
+    } else {
+        HMICX_LOG(HMICX_LVL_INFO, "🚀 Starting streaming parse()...");
+        parseStream();
+        HMICX_LOG(HMICX_LVL_INFO, "✅ Streaming parse complete!");
+    }
+    
+    // parallel mode times its pre-pass itself, otherwise scanning is whatever
+    // wasn't spent inside parseFrameBody
+    HMICX_STAT(
+        stats.totalNs += statClockNs() - t0;
+        if (!(mapped && threadCount > 1)) stats.scanNs = stats.totalNs - stats.frameNs - stats.mergeNs;
+    )
+}
+
+// 🧠 SINGLE-PASS STATE MACHINE - finds info{} and F..{} blocks in ONE read.
+// Works on whatever bytes we have so far: `data` is the current window, scan.pos
+// is where we stopped last time. Complete blocks are handed off as string_views
+// into `data`. Returns the offset before which nothing is needed anymore, so the
+// streaming caller can drop that prefix (a mapped caller just ignores it).
+// When eof is false, a token cut off by the end of the window is left for later
+// instead of being guessed at.
+size_t Parser::scanBlocks(string_view data, bool eof) {
+    size_t len = data.size();
+    size_t i = scan.pos;
+    
+    while (i < len) {
+        if (scan.state == ScanState::IN_INFO || scan.state == ScanState::IN_FRAME) {
+            // 🏎️ only braces matter in here - jump straight to the next one
+            i = findBrace(data.data() + i, data.data() + len) - data.data();
+            if (i >= len) break;
+            char c = data[i];
+            if (c == '{') scan.depth++;
+            else if (c == '}' && --scan.depth == 0) {
+                string_view body = data.substr(scan.bodyStart, i - scan.bodyStart);
+                
+                if (scan.state == ScanState::IN_INFO) {
+                    HMICX_LOG(HMICX_LVL_BLOCK, "✅ Found closing brace! Header length: " << body.size());
+                    parseHeaderBody(body);
+                    scan.headerDone = true;
+                    scan.headerSpan = {scan.base + scan.bodyStart, body.size(), 0, 0};
                     
-                    if (pos < accumulator.size() && accumulator[pos] == '-') {
-                        pos++;
-                        frameEnd = fastExtractNumber(accumulator.c_str(), accumulator.size(), pos);
+                    if (stopOnHeader) {
+                        scan.state = ScanState::LOOKING;
+                        scan.pos = i + 1;
+                        scan.yielded = true;
+                        return scan.pos;
                     }
+                } else if (collectBlocks) {
+                    // pre-pass only: remember where the block is, parse it later
+                    collectBlocks->push_back({scan.base + scan.bodyStart, body.size(),
+                                              scan.frameStart, scan.frameEnd, scan.frameRanges});
+                    scan.framesFound++;
+                } else {
+                    HMICX_LOG(HMICX_LVL_BLOCK, "✅ Frame " << scan.frameStart << "-" << scan.frameEnd
+                         << " complete! Size: " << body.size());
+                    CommandList& dst = emitTo ? emitTo->commands : commands;
+                    size_t before = dst.size();
+                    HMICX_STAT(uint64_t t0 = statClockNs();)
+                    parseFrameBody(body, scan.frameStart, scan.frameEnd, scan.frameRanges, dst);
+                    HMICX_STAT(stats.frameNs += statClockNs() - t0;)
+                    indexColors(dst, before);
+                    scan.framesFound++;
+                    HMICX_STAT(stats.blocks++;)
                     
-                    cout << "[DEBUG] 📍 Frame range: " << frameStart << "-" << frameEnd << endl;
-                    
-                    // Skip to opening brace
-                    while (pos < accumulator.size() && isspace(accumulator[pos])) pos++;
-                    
-                    if (pos < accumulator.size() && accumulator[pos] == '{') {
-                        state = IN_FRAME;
-                        braceDepth = 1;
-                        i = pos;
-                        frameContent.clear();
-                        cout << "[DEBUG] 📦 Entering frame body!" << endl;
+                    // 🚰 pull mode: hand this one block back to nextBlock()
+                    if (emitTo) {
+                        emitTo->start = scan.frameStart;
+                        emitTo->end = scan.frameEnd;
+                        emitTo->ranges = scan.frameRanges;
+                        scan.state = ScanState::LOOKING;
+                        scan.pos = i + 1;
+                        scan.yielded = true;
+                        return scan.pos;
                     }
                 }
-            } else {
-                // IN_FRAME state - collect frame content
-                if (accumulator[i] == '{') braceDepth++;
-                else if (accumulator[i] == '}') {
-                    braceDepth--;
-                    if (braceDepth == 0) {
-                        // Frame complete!
-                        cout << "[DEBUG] ✅ Frame " << frameStart << "-" << frameEnd << " complete! Size: " << frameContent.size() << endl;
-                        
-                        parseFrameBody(frameContent.c_str(), frameContent.size(), frameStart, frameEnd);
-                        
-                        state = LOOKING_FOR_FRAME;
-                        frames_found++;
-                        processedUntil = i + 1;
-                        frameContent.clear();
-                        continue;
+                scan.state = ScanState::LOOKING;
+            }
+            i++;
+            continue;
+        }
+        
+        // LOOKING - everything from i on is unclaimed, try to start a block here
+        char c = data[i];
+        
+        // 📋 info{ ... } block
+        if (!scan.headerDone && (c == 'i' || c == 'I')) {
+            size_t avail = len - i;
+            if (avail < 4) {
+                if (!eof && fastStartsWith(data.data() + i, avail, "info", avail)) break;
+            } else if (fastStartsWith(data.data() + i, avail, "info", 4)) {
+                size_t j = i + 4;
+                while (j < len && isspace(static_cast<unsigned char>(data[j]))) j++;
+                if (j >= len && !eof) break;  // brace might be in the next chunk
+                
+                if (j < len && data[j] == '{') {
+                    HMICX_LOG(HMICX_LVL_BLOCK, "📦 Found info block!");
+                    scan.state = ScanState::IN_INFO;
+                    scan.depth = 1;
+                    scan.bodyStart = j + 1;
+                    i = j + 1;
+                    continue;
+                }
+            }
+        }
+        
+        // 🎬 F1234{ or F1-10{ or F1-3,5,9-12{ block
+        if (c == 'F' || c == 'f') {
+            if (i + 1 >= len && !eof) break;
+            
+            if (i + 1 < len && isdigit(static_cast<unsigned char>(data[i + 1]))) {
+                size_t p = i + 1;
+                int frameStart = fastExtractNumber(data.data(), len, p);
+                int frameEnd = frameStart;
+                
+                if (p < len && data[p] == '-') {
+                    p++;
+                    frameEnd = fastExtractNumber(data.data(), len, p);
+                }
+                
+                // more ranges after commas → keep the list, start/end become the hull
+                FrameRanges ranges;
+                while (p < len && data[p] == ',') {
+                    if (ranges.empty()) ranges.push_back({frameStart, frameEnd});
+                    p++;
+                    int lo = fastExtractNumber(data.data(), len, p);
+                    int hi = lo;
+                    if (p < len && data[p] == '-') {
+                        p++;
+                        hi = fastExtractNumber(data.data(), len, p);
                     }
+                    ranges.push_back({lo, hi});
+                    frameStart = min(frameStart, lo);
+                    frameEnd = max(frameEnd, hi);
                 }
                 
-                if (braceDepth > 0) {
-                    frameContent += accumulator[i];
+                while (p < len && isspace(static_cast<unsigned char>(data[p]))) p++;
+                if (p >= len && !eof) break;  // marker cut in half, wait for more bytes
+                
+                if (p < len && data[p] == '{') {
+                    HMICX_LOG(HMICX_LVL_BLOCK, "📍 Frame range: " << frameStart << "-" << frameEnd
+                              << (ranges.empty() ? "" : " (" + to_string(ranges.size()) + " ranges)"));
+                    scan.state = ScanState::IN_FRAME;
+                    scan.frameStart = frameStart;
+                    scan.frameEnd = frameEnd;
+                    scan.frameRanges = std::move(ranges);
+                    scan.depth = 1;
+                    scan.bodyStart = p + 1;
+                    i = p + 1;
+                    continue;
                 }
-                processedUntil = i + 1;
             }
         }
         
-        // Keep unprocessed data for next iteration
-        if (state == LOOKING_FOR_FRAME) {
-            // Keep last 100 chars in case frame marker spans chunks
-            if (accumulator.size() > 100) {
-                accumulator = accumulator.substr(accumulator.size() - 100);
-            } else {
-                accumulator.clear();
-            }
-        } else {
-            // In frame - keep everything after processed
-            if (processedUntil > 0) {
-                accumulator = accumulator.substr(processedUntil);
-            }
+        i++;
+    }
+    
+    scan.pos = i;
+    return (scan.state == ScanState::LOOKING) ? i : scan.bodyStart;
+}
+
+// ⚡ ZERO-COPY PATH: the whole mapping is one window, every block is handed to
+// parseFrameBody as a string_view straight into the mapped pages
+void Parser::parseMapped() {
+    commands.commands.reserve(1000);
+    scanBlocks(string_view(mapped, mappedSize), true);
+    
+    if (scan.state != ScanState::LOOKING) {
+        HMICX_LOG(HMICX_LVL_INFO, "❌ File ended inside a block (missing closing brace)!");
+    }
+    HMICX_LOG(HMICX_LVL_INFO, "🎬 Total frames found: " << scan.framesFound);
+    HMICX_LOG(HMICX_LVL_INFO, "📊 Total commands: " << commands.size());
+}
+
+// 🧵 PARALLEL PATH: a cheap pre-pass finds every top-level F..{} block (brace
+// depth only), then worker threads parse blocks into their own command vectors
+// and the results are stitched back together in file order.
+void Parser::parseParallel() {
+    string_view data(mapped, mappedSize);
+    
+    HMICX_STAT(uint64_t tScan = statClockNs();)
+    vector<BlockSpan> blocks;
+    collectBlocks = &blocks;
+    scanBlocks(data, true);
+    collectBlocks = nullptr;
+    HMICX_STAT(stats.scanNs += statClockNs() - tScan;)
+    
+    if (scan.state != ScanState::LOOKING) {
+        HMICX_LOG(HMICX_LVL_INFO, "❌ File ended inside a block (missing closing brace)!");
+    }
+    
+    unsigned workers = min<size_t>(threadCount, blocks.size());
+    HMICX_LOG(HMICX_LVL_INFO, "🧵 Found " << blocks.size() << " frame blocks, parsing with "
+         << workers << " threads");
+    
+    vector<CommandList> results(blocks.size());  // each block gets its own little arena
+    atomic<size_t> next{0};
+    HMICX_STAT(atomic<uint64_t> frameNs{0};)
+    
+    auto worker = [&]() {
+        HMICX_STAT(uint64_t t0 = statClockNs();)
+        for (size_t b = next++; b < blocks.size(); b = next++) {
+            const BlockSpan& blk = blocks[b];
+            parseFrameBody(data.substr(blk.offset, blk.length), blk.start, blk.end, blk.ranges, results[b]);
+        }
+        HMICX_STAT(frameNs += statClockNs() - t0;)
+    };
+    
+    vector<thread> pool;
+    for (unsigned t = 1; t < workers; t++) pool.emplace_back(worker);
+    worker(); // this thread pitches in too
+    for (auto& t : pool) t.join();
+    
+    HMICX_STAT(
+        stats.frameNs += frameNs;
+        stats.blocks += blocks.size();
+        uint64_t tMerge = statClockNs();
+    )
+    
+    // 🧩 Merge in file order - palette indices are handed out here so they
+    // come out exactly like a serial parse
+    size_t totalCmds = 0, totalRuns = 0, totalSingles = 0;
+    for (const auto& r : results) {
+        totalCmds += r.commands.size();
+        totalRuns += r.runs.size();
+        totalSingles += r.singles.size();
+    }
+    commands.commands.reserve(commands.commands.size() + totalCmds);
+    commands.runs.reserve(commands.runs.size() + totalRuns);
+    commands.singles.reserve(commands.singles.size() + totalSingles);
+    
+    for (auto& r : results) {
+        size_t before = commands.size();
+        commands.append(r);
+        r = CommandList{};  // give the block's memory back right away
+        indexColors(commands, before);
+    }
+    HMICX_STAT(stats.mergeNs += statClockNs() - tMerge;)
+    
+    HMICX_LOG(HMICX_LVL_INFO, "🎬 Total frames found: " << scan.framesFound);
+    HMICX_LOG(HMICX_LVL_INFO, "📊 Total commands: " << commands.size());
+}
+
+// 🌊 Run the scanner until it yields (a block for nextBlock(), or the header for
+// readHeader()) or the input is used up. Streaming input is read 8KB at a time
+// from the one open file (works on pipes too) and only the unfinished
+// block/token is carried over between chunks. Returns true if it yielded.
+bool Parser::pump() {
+    if (mapped) {
+        scanBlocks(string_view(mapped, mappedSize), true);
+        bool yielded = scan.yielded;
+        scan.yielded = false;
+        return yielded;
+    }
+    
+    for (;;) {
+        size_t keepFrom = scanBlocks(window, inputEof);
+        
+        // Drop what's done, shift the saved offsets to match
+        if (keepFrom > 0) {
+            window.erase(0, keepFrom);
+            scan.base += keepFrom;
+            scan.pos -= keepFrom;
+            if (scan.state != ScanState::LOOKING) scan.bodyStart -= keepFrom;
+        }
+        
+        if (scan.yielded) {
+            scan.yielded = false;
+            return true;
+        }
+        if (inputEof) return false;
+        
+        size_t have = window.size();
+        window.resize(have + BUFFER_SIZE);
+        size_t got = readInput(&window[have], BUFFER_SIZE);
+        window.resize(have + got);
+        HMICX_STAT(stats.bytesRead += got;)
+    }
+}
+
+// 🌊 STREAMING FALLBACK: the same state machine, fed by pump()
+void Parser::parseStream() {
+    commands.commands.reserve(1000);
+    
+    while (pump()) {}  // nothing asks for a yield here, so this runs to the end
+    
+    stream.close();
+    
+    if (!scan.headerDone) {
+        HMICX_LOG(HMICX_LVL_INFO, "⚠️ No complete header found in file!");
+    }
+    if (scan.state != ScanState::LOOKING) {
+        HMICX_LOG(HMICX_LVL_INFO, "❌ File ended inside a block (missing closing brace)!");
+    }
+    HMICX_LOG(HMICX_LVL_INFO, "🎬 Total frames found: " << scan.framesFound);
+    HMICX_LOG(HMICX_LVL_INFO, "📊 Total commands: " << commands.size());
+}
+
+// 📥 Next chunk for the streaming path: raw file bytes, or freshly decompressed
+// zstd output (works without knowing the content size up front). Sets inputEof.
+size_t Parser::readInput(char* dst, size_t cap) {
+    if (!zstd) {
+        stream.read(dst, cap);
+        inputEof = !stream;
+        return stream.gcount();
+    }
+    
+    ZSTD_outBuffer out{dst, cap, 0};
+    while (out.pos < out.size) {
+        // (also flushes output the stream is still holding when there's no new input)
+        size_t inBefore = zstd->in.pos, outBefore = out.pos;
+        size_t ret = ZSTD_decompressStream(zstd->ds, &out, &zstd->in);
+        if (ZSTD_isError(ret)) throw runtime_error(string("Zstd decompression failed: ") + ZSTD_getErrorName(ret));
+        if (zstd->in.pos != inBefore || out.pos != outBefore) {
+            zstd->lastRet = ret;
+            continue;
+        }
+        
+        // stuck → needs more compressed bytes
+        if (!compressedMemory.empty() || !stream) {
+            // input's done - anything but a clean frame boundary is a cut-off file
+            if (zstd->lastRet != 0) throw runtime_error("Truncated zstd stream" + (filepath.empty() ? string() : ": " + filepath));
+            inputEof = true;
+            break;
+        }
+        stream.read(zstd->inBuf.data(), zstd->inBuf.size());
+        zstd->in = {zstd->inBuf.data(), static_cast<size_t>(stream.gcount()), 0};
+    }
+    return out.pos;
+}
+
+void Parser::closeInput() {
+    if (stream.is_open()) stream.close();
+    zstd.reset();
+    window.clear();
+    inputOpen = mapped != nullptr;  // a mapping stays usable, a stream has to be reopened
+    inputEof = false;
+}
+
+// 🗂️ One pass, brace depth only - nothing gets parsed except the header
+BlockIndex Parser::buildIndex() {
+    HMICX_LOG(HMICX_LVL_INFO, "🗂️ Building block index for " << filepath);
+    
+    scan = ScanState{};
+    closeInput();
+    openInput();
+    
+    BlockIndex idx;
+    collectBlocks = &idx.blocks;
+    pump();
+    collectBlocks = nullptr;
+    closeInput();
+    
+    idx.hasHeader = scan.headerDone;
+    idx.header = scan.headerSpan;
+    
+    struct stat st;
+    if (stat(filepath.c_str(), &st) == 0) {
+        idx.fileSize = st.st_size;
+        idx.fileMtime = st.st_mtime;
+    }
+    
+    HMICX_LOG(HMICX_LVL_INFO, "🗂️ Indexed " << idx.blocks.size() << " frame blocks");
+    return idx;
+}
+
+const BlockIndex& Parser::loadOrBuildIndex() {
+    if (indexLoaded) return index;
+    if (compressed) throw runtime_error("Random access needs an uncompressed .hmic, this one is zstd: " + filepath);
+    
+    if (filepath.empty()) {
+        // 🧠 memory buffer - nothing to cache next to, just keep it in memory
+        index = buildIndex();
+        indexLoaded = true;
+        return index;
+    }
+    
+    string idxPath = indexPathFor(filepath);
+    struct stat st;
+    bool haveStat = stat(filepath.c_str(), &st) == 0;
+    
+    if (haveStat && S_ISREG(st.st_mode) && loadIndex(idxPath, index) &&
+        index.fileSize == (uint64_t)st.st_size && index.fileMtime == (int64_t)st.st_mtime) {
+        HMICX_LOG(HMICX_LVL_INFO, "🗂️ Using index " << idxPath << " (" << index.blocks.size() << " blocks)");
+    } else {
+        index = buildIndex();
+        // pipes can't be seeked later anyway, only cache indexes of real files
+        if (haveStat && S_ISREG(st.st_mode) && !saveIndex(idxPath, index)) {
+            HMICX_LOG(HMICX_LVL_INFO, "⚠️ Couldn't write index " << idxPath << " (still using it in memory)");
         }
     }
     
-    file.close();
+    indexLoaded = true;
+    return index;
+}
+
+// Bytes of one span - straight from the mapping, or seek + read into scratch
+string_view Parser::readSpan(const BlockSpan& span, string& scratch) {
+    HMICX_STAT(stats.bytesRead += span.length;)
+    if (mapped) {
+        if (span.offset + span.length > mappedSize) throw runtime_error("Index points past end of file: " + filepath);
+        return string_view(mapped + span.offset, span.length);
+    }
+    
+    ifstream f(filepath, ios::binary);
+    if (!f.is_open()) throw runtime_error("Cannot open file: " + filepath);
+    f.seekg(span.offset);
+    scratch.resize(span.length);
+    if (!f.read(&scratch[0], span.length)) throw runtime_error("Index points past end of file: " + filepath);
+    return scratch;
+}
+
+void Parser::parseFramesInRange(int a, int b) {
+    HMICX_STAT(uint64_t t0 = statClockNs();)
+    const BlockIndex& idx = loadOrBuildIndex();
+    
+    if (mode != ParseMode::Stream && !mapped) mapFile();
+    if (mode == ParseMode::Mmap && !mapped) throw runtime_error("Cannot mmap file: " + filepath);
+    
+    string scratch;
+    if (idx.hasHeader && !scan.headerDone) {
+        parseHeaderBody(readSpan(idx.header, scratch));
+        scan.headerDone = true;
+    }
+    
+    commands.clear();
+    int used = 0;
+    for (const BlockSpan& blk : idx.blocks) {
+        if (!blk.overlaps(a, b)) continue;
+        size_t before = commands.size();
+        string_view body = readSpan(blk, scratch);
+        HMICX_STAT(uint64_t tf = statClockNs();)
+        parseFrameBody(body, blk.start, blk.end, blk.ranges, commands);
+        HMICX_STAT(stats.frameNs += statClockNs() - tf; stats.blocks++;)
+        indexColors(commands, before);
+        used++;
+    }
+    HMICX_STAT(
+        stats.totalNs += statClockNs() - t0;
+        stats.scanNs = stats.totalNs - stats.frameNs - stats.mergeNs;
+    )
+    
+    HMICX_LOG(HMICX_LVL_INFO, "🎯 Frames " << a << "-" << b << ": parsed " << used << "/" << idx.blocks.size()
+         << " blocks → " << commands.size() << " commands");
+}
+
+// 📋 Pull just far enough to have the info{} block. If a frame block shows up
+// first it's parked and nextBlock() hands it out before reading further.
+bool Parser::readHeader() {
+    if (scan.headerDone) return true;
+    openInput();
+    
+    pending.commands.clear();
+    emitTo = &pending;
+    stopOnHeader = true;
+    bool yielded = pump();
+    emitTo = nullptr;
+    stopOnHeader = false;
     
-    cout << "[DEBUG] 🎬 Total frames found: " << frames_found << endl;
-    cout << "[DEBUG] 📊 Total commands: " << commands.size() << endl;
+    if (yielded && !scan.headerDone) hasPending = true;
+    return scan.headerDone;
 }
 
-void Parser::parseFrameBody(const char* body, size_t len, int start, int end) {
-    cout << "[DEBUG] 🔍 parseFrameBody called! Frame " << start << "-" << end << ", body length: " << len << endl;
+// 🚰 Pull ONE parsed frame block. Only that block's commands are in memory;
+// `out` is reused between calls so its vector capacity sticks around.
+bool Parser::nextBlock(FrameBlock& out) {
+    if (hasPending) {
+        std::swap(out, pending);
+        hasPending = false;
+        return true;
+    }
+    openInput();
+    
+    HMICX_STAT(uint64_t t0 = statClockNs();)
+    out.commands.clear();
+    emitTo = &out;
+    bool yielded = pump();
+    emitTo = nullptr;
+    HMICX_STAT(
+        stats.totalNs += statClockNs() - t0;
+        stats.scanNs = stats.totalNs - stats.frameNs - stats.mergeNs;
+    )
+    
+    if (!yielded) {
+        if (stream.is_open()) stream.close();
+        HMICX_LOG(HMICX_LVL_INFO, "🏁 No more frame blocks (" << scan.framesFound << " total)");
+    }
+    return yielded;
+}
+
+void Parser::parseHeaderBody(string_view body) {
+    HMICX_LOG(HMICX_LVL_BLOCK, "📝 Parsing header body (length: " << body.size() << ")");
+    [[maybe_unused]] int lines_parsed = parseHeaderLines(body, header);
+    HMICX_LOG(HMICX_LVL_BLOCK, "📊 Parsed " << lines_parsed << " header lines");
+}
+
+void Parser::parseFrameBody(string_view body, int start, int end, const FrameRanges& ranges, CommandList& out) {
+    size_t len = body.size();
+    HMICX_LOG(HMICX_LVL_BLOCK, "🔍 parseFrameBody called! Frame " << start << "-" << end << ", body length: " << len);
     
     size_t pos = 0;
     int colors_found = 0;
-    int commands_before = commands.size();
+    size_t commands_before = out.size();
+    
+    // 🎞️ multi-range block: every command in it shares ONE frame set
+    uint32_t frameSet = 0;
+    if (!ranges.empty()) {
+        out.frameSets.emplace_back(ranges);
+        frameSet = static_cast<uint32_t>(out.frameSets.size());
+    }
     
     while (pos < len) {
-        string color;
+        string_view color;
         
         // 🎨 Check for rgba(...)
-        if (pos + 5 <= len && fastStartsWith(body + pos, len - pos, "rgba(", 5)) {
-            cout << "[DEBUG]   🎨 Found 'rgba(' at pos " << pos << endl;
+        if (pos + 5 <= len && fastStartsWith(body.data() + pos, len - pos, "rgba(", 5)) {
+            HMICX_LOG(HMICX_LVL_TRACE, "  🎨 Found 'rgba(' at pos " << pos);
             
             size_t parenEnd = pos + 5;
             while (parenEnd < len && body[parenEnd] != ')') parenEnd++;
             
             if (parenEnd < len && body[parenEnd] == ')') {
-                color.assign(body + pos, parenEnd - pos + 1);
-                cout << "[DEBUG]   ✅ Extracted RGBA color: " << color << endl;
+                color = body.substr(pos, parenEnd - pos + 1);
+                HMICX_LOG(HMICX_LVL_TRACE, "  ✅ Extracted RGBA color: " << color);
                 pos = parenEnd + 1;
                 colors_found++;
             } else {
@@ -274,15 +792,15 @@ void Parser::parseFrameBody(const char* body, size_t len, int start, int end) {
             }
         }
         // 🎨 Check for rgb(...)
-        else if (pos + 4 <= len && fastStartsWith(body + pos, len - pos, "rgb(", 4)) {
-            cout << "[DEBUG]   🎨 Found 'rgb(' at pos " << pos << endl;
+        else if (pos + 4 <= len && fastStartsWith(body.data() + pos, len - pos, "rgb(", 4)) {
+            HMICX_LOG(HMICX_LVL_TRACE, "  🎨 Found 'rgb(' at pos " << pos);
             
             size_t parenEnd = pos + 4;
             while (parenEnd < len && body[parenEnd] != ')') parenEnd++;
             
             if (parenEnd < len && body[parenEnd] == ')') {
-                color.assign(body + pos, parenEnd - pos + 1);
-                cout << "[DEBUG]   ✅ Extracted RGB color: " << color << endl;
+                color = body.substr(pos, parenEnd - pos + 1);
+                HMICX_LOG(HMICX_LVL_TRACE, "  ✅ Extracted RGB color: " << color);
                 pos = parenEnd + 1;
                 colors_found++;
             } else {
@@ -300,8 +818,8 @@ void Parser::parseFrameBody(const char* body, size_t len, int start, int end) {
                 }
             }
             if (isHex) {
-                color.assign(body + pos, 7);
-                cout << "[DEBUG]   ✅ Extracted HEX color: " << color << endl;
+                color = body.substr(pos, 7);
+                HMICX_LOG(HMICX_LVL_TRACE, "  ✅ Extracted HEX color: " << color);
                 pos += 7;
                 colors_found++;
             } else {
@@ -315,151 +833,564 @@ void Parser::parseFrameBody(const char* body, size_t len, int start, int end) {
         }
         
         if (color.empty()) {
-            cout << "[DEBUG]   ❌ Color is empty after detection?!" << endl;
+            HMICX_LOG(HMICX_LVL_TRACE, "  ❌ Color is empty after detection?!");
             continue;
         }
         
         // Skip whitespace to find opening brace
-        while (pos < len && isspace(body[pos])) pos++;
+        while (pos < len && isSpaceC(body[pos])) pos++;
         
         if (pos >= len) {
-            cout << "[DEBUG]   ❌ Reached end of body!" << endl;
+            HMICX_LOG(HMICX_LVL_TRACE, "  ❌ Reached end of body!");
             break;
         }
         
         if (body[pos] != '{') {
-            cout << "[DEBUG]   ⚠️ No opening brace found for color " << color << endl;
+            HMICX_LOG(HMICX_LVL_TRACE, "  ⚠️ No opening brace found for color " << color);
             continue;
         }
         
         // Find matching closing brace
-        size_t blockEnd = findMatchingBrace(body, len, pos);
+        size_t blockEnd = findMatchingBrace(body.data(), len, pos);
         
         if (blockEnd == string::npos) {
-            cout << "[DEBUG]   ❌ No matching closing brace!" << endl;
+            HMICX_LOG(HMICX_LVL_TRACE, "  ❌ No matching closing brace!");
             break;
         }
         
         size_t pixelBodyLen = blockEnd - pos - 1;
         
-        // Parse pixels inside the block
-        vector<Pixel> pixels = parsePixels(body + pos + 1, pixelBodyLen);
+        // 🎨 Decode the color ONCE here so nobody downstream ever sees a string
+        uint32_t rgba = decodeColor(color);
+        
+        // Parse pixels straight onto the end of the arena (palette slot is assigned by the caller)
+        Command cmd{start, end, static_cast<uint32_t>(out.runs.size()), 0,
+                    static_cast<uint32_t>(out.singles.size()), 0, rgba, 0, frameSet};
+        parsePixels(body.substr(pos + 1, pixelBodyLen), cmd, out);
         
-        cout << "[DEBUG]   💎 Parsed " << pixels.size() << " pixels for color " << color << endl;
+        HMICX_LOG(HMICX_LVL_TRACE, "  💎 Parsed " << cmd.runCount << " runs + " << cmd.singleCount
+             << " singles for color " << color);
         
-        if (!pixels.empty()) {
-            commands.push_back({start, end, std::move(pixels), std::move(color)});
-            cout << "[DEBUG]   ✅ Added command with " << pixels.size() << " pixels" << endl;
+        // (an empty command added nothing to the arena, so there's nothing to roll back)
+        if (cmd.runCount || cmd.singleCount) {
+            out.commands.push_back(cmd);
+            HMICX_LOG(HMICX_LVL_TRACE, "  ✅ Added command with " << out.pixelCount(cmd) << " pixels");
         }
         
         pos = blockEnd + 1;
     }
     
-    int commands_added = commands.size() - commands_before;
-    cout << "[DEBUG] 🎨 Frame summary: " << colors_found << " colors found, " << commands_added << " commands added" << endl;
+    if (frameSet && out.size() == commands_before) out.frameSets.pop_back();  // nobody uses it
+    
+    HMICX_LOG(HMICX_LVL_BLOCK, "🎨 Frame summary: " << colors_found << " colors found, "
+              << (out.size() - commands_before) << " commands added");
+}
+
+// 🎨 Deduplicated per-file color table
+uint32_t Parser::paletteIndexFor(uint32_t rgba) {
+    auto [it, inserted] = paletteLookup.try_emplace(rgba, static_cast<uint32_t>(palette.size()));
+    if (inserted) palette.push_back(rgba);
+    return it->second;
+}
+
+// Give cmds[from..] their palette slots (always done in file order)
+// (every parse path funnels through here, so it's also where the counters live)
+void Parser::indexColors(CommandList& cmds, size_t from) {
+    for (size_t i = from; i < cmds.commands.size(); i++) {
+        Command& c = cmds.commands[i];
+        c.paletteIndex = paletteIndexFor(c.rgba);
+        HMICX_STAT(
+            stats.commands++;
+            stats.runs += c.runCount;
+            stats.singles += c.singleCount;
+            stats.pixels += cmds.pixelCount(c);
+        )
+    }
+}
+
+void CommandList::append(const CommandList& other) {
+    uint32_t runBase = static_cast<uint32_t>(runs.size());
+    uint32_t singleBase = static_cast<uint32_t>(singles.size());
+    uint32_t frameSetBase = static_cast<uint32_t>(frameSets.size());
+    runs.insert(runs.end(), other.runs.begin(), other.runs.end());
+    singles.insert(singles.end(), other.singles.begin(), other.singles.end());
+    frameSets.insert(frameSets.end(), other.frameSets.begin(), other.frameSets.end());
+    for (Command c : other.commands) {
+        c.runOffset += runBase;
+        c.singleOffset += singleBase;
+        if (c.frameSet) c.frameSet += frameSetBase;
+        commands.push_back(c);
+    }
+}
+
+FrameIndex::FrameIndex(const CommandList& cmds) : list(&cmds) {
+    byStart.resize(cmds.size());
+    for (uint32_t i = 0; i < byStart.size(); i++) byStart[i] = i;
+    stable_sort(byStart.begin(), byStart.end(), [&](uint32_t a, uint32_t b) {
+        return cmds[a].start < cmds[b].start;
+    });
+    hasFrameSets = !cmds.frameSets.empty();
+    HMICX_LOG(HMICX_LVL_INFO, "⏱️ Frame index over " << cmds.size() << " commands");
+}
+
+// 🎞️ hull-active isn't enough for F1-3,5,... blocks - drop the ones not on cur
+void FrameIndex::filterFrameSets() {
+    if (!hasFrameSets) return;
+    on.clear();
+    for (uint32_t i : live) {
+        const Command& c = (*list)[i];
+        if (c.frameSet == 0 || list->frameSets[c.frameSet - 1].contains(cur)) on.push_back(i);
+    }
+}
+
+void FrameIndex::seek(int f) {
+    cur = f;
+    live.clear();
+    nextStart = 0;
+    while (nextStart < byStart.size() && (*list)[byStart[nextStart]].start <= f) {
+        uint32_t i = byStart[nextStart++];
+        if ((*list)[i].end >= f) live.push_back(i);
+    }
+    sort(live.begin(), live.end());
+    filterFrameSets();
+}
+
+void FrameIndex::next() {
+    int f = ++cur;
+    const CommandList& cmds = *list;
+    
+    // ended on the previous frame → out
+    live.erase(remove_if(live.begin(), live.end(), [&](uint32_t i) { return cmds[i].end < f; }), live.end());
+    
+    // starting now → in, merged back into file order
+    size_t before = live.size();
+    while (nextStart < byStart.size() && cmds[byStart[nextStart]].start <= f) {
+        uint32_t i = byStart[nextStart++];
+        if (cmds[i].end >= f) live.push_back(i);
+    }
+    if (live.size() > before) {
+        sort(live.begin() + before, live.end());
+        inplace_merge(live.begin(), live.begin() + before, live.end());
+    }
+    filterFrameSets();
 }
 
-vector<Pixel> Parser::parsePixels(const char* body, size_t len) {
-    cout << "[DEBUG]     🔍 parsePixels called with length " << len << endl;
+FrameSet::FrameSet(const FrameRanges& ranges) {
+    bool any = false;
+    for (const auto& [lo, hi] : ranges) {
+        if (lo > hi) continue;
+        first = any ? min(first, lo) : lo;
+        last = any ? max(last, hi) : hi;
+        any = true;
+    }
+    if (!any) return;  // first > last, contains() is always false
     
-    vector<Pixel> pixels;
-    pixels.reserve(100);
+    size_t n = static_cast<size_t>(last - first) + 1;
+    bits.assign((n + 63) / 64, 0);
+    for (const auto& [lo, hi] : ranges) {
+        for (int f = lo; f <= hi; f++) {
+            unsigned i = static_cast<unsigned>(f - first);
+            bits[i >> 6] |= uint64_t(1) << (i & 63);
+        }
+    }
+}
+
+// 🔢 Read the digit run at p (advancing p), 0 digits = v untouched.
+// SWAR: one 8-byte load classifies all 8 bytes as digit/non-digit at once and
+// converts up to 8 digits with three multiplies instead of a branch per char.
+static inline int readDigits(const char*& p, const char* end, int& v) {
+    if (end - p >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        // a byte is a digit iff its high nibble is 3 both before and after +6
+        uint64_t hi = w & 0xF0F0F0F0F0F0F0F0ULL;
+        uint64_t hi6 = (w + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL;
+        uint64_t bad = (hi ^ 0x3030303030303030ULL) | (hi6 ^ 0x3030303030303030ULL);
+        bad = (((bad & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | bad) & 0x8080808080808080ULL;
+        int n = bad ? __builtin_ctzll(bad) / 8 : 8;
+        if (n == 0) return 0;
+        if (n < 8) {
+            // digits are the low n bytes: push them to the top so the ones below act as leading zeros
+            uint64_t d = (w - 0x3030303030303030ULL) << (8 * (8 - n));
+            d = (d * 10 + (d >> 8)) & 0x00FF00FF00FF00FFULL;
+            d = (d * 100 + (d >> 16)) & 0x0000FFFF0000FFFFULL;
+            d = (d * 10000 + (d >> 32)) & 0xFFFFFFFFULL;
+            v = static_cast<int>(d);
+            p += n;
+            return n;
+        }
+    }
+    // short tail / very long number: plain loop
+    int n = 0, x = 0;
+    while (p < end && static_cast<unsigned char>(*p - '0') < 10) {
+        x = x * 10 + (*p - '0');
+        p++;
+        n++;
+    }
+    if (n) v = x;
+    return n;
+}
+
+static const int POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+void Parser::parsePixels(string_view body, Command& cmd, CommandList& out) {
+    HMICX_LOG(HMICX_LVL_TRACE, "    🔍 parsePixels called with length " << body.size());
     
-    size_t lineStart = 0;
     int p_commands = 0;
     int pl_commands = 0;
     
-    for (size_t i = 0; i <= len; i++) {
-        if (i == len || body[i] == '\n') {
-            size_t start = lineStart;
-            size_t end = i;
+    const char* p = body.data();
+    const char* bodyEnd = p + body.size();
+    
+    while (p <= bodyEnd) {
+        // 🏎️ vector search for the end of the line, then trim it
+        const char* nl = findNewline(p, bodyEnd);
+        const char* start = p;
+        const char* end = nl;
+        while (start < end && isSpaceC(*start)) start++;
+        while (start < end && isSpaceC(end[-1])) end--;
+        
+        // Check for P= command
+        if (end - start > 2 && (start[0] == 'p' || start[0] == 'P') && start[1] == '=') {
+            p_commands++;
+            const char* pos = start + 2;
             
-            while (start < end && isspace(body[start])) start++;
-            while (start < end && isspace(body[end - 1])) end--;
+            while (pos < end) {
+                const char* before = pos;
+                int x = 0, y = 0;
+                bool hasX = readDigits(pos, end, x) > 0;
+                bool hasY = false;
+                
+                if (pos < end && (*pos == 'x' || *pos == 'X')) {
+                    pos++;
+                    hasY = readDigits(pos, end, y) > 0;
+                }
+                
+                if (hasX && hasY) {
+                    out.singles.push_back({x, y});
+                }
+                
+                if (pos < end && *pos == ',') pos++;
+                while (pos < end && isSpaceC(*pos)) pos++;
+                if (pos == before) pos++;  // junk byte - skip it instead of spinning
+            }
+        }
+        // Check for PL= command
+        else if (end - start > 3 && (start[0] == 'p' || start[0] == 'P') &&
+                 (start[1] == 'l' || start[1] == 'L') && start[2] == '=') {
+            pl_commands++;
+            const char* pos = start + 3;
+            int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+            int* current = &x1;
             
-            if (end > start) {
-                // Check for P= command
-                if (end - start > 2 && (body[start] == 'p' || body[start] == 'P') && body[start + 1] == '=') {
-                    p_commands++;
-                    size_t pos = start + 2;
-                    
-                    while (pos < end) {
-                        int x = 0, y = 0;
-                        bool hasX = false, hasY = false;
-                        
-                        while (pos < end && isdigit(body[pos])) {
-                            x = x * 10 + (body[pos] - '0');
-                            pos++;
-                            hasX = true;
-                        }
-                        
-                        if (pos < end && (body[pos] == 'x' || body[pos] == 'X')) {
-                            pos++;
-                            while (pos < end && isdigit(body[pos])) {
-                                y = y * 10 + (body[pos] - '0');
-                                pos++;
-                                hasY = true;
-                            }
-                        }
-                        
-                        if (hasX && hasY) {
-                            pixels.push_back({x, y});
-                        }
-                        
-                        if (pos < end && body[pos] == ',') pos++;
-                        while (pos < end && isspace(body[pos])) pos++;
-                    }
+            while (pos < end) {
+                int v = 0;
+                if (int n = readDigits(pos, end, v)) {
+                    *current = *current * POW10[min(n, 9)] + v;
+                    continue;
                 }
-                // Check for PL= command
-                else if (end - start > 3 && (body[start] == 'p' || body[start] == 'P') && 
-                         (body[start + 1] == 'l' || body[start + 1] == 'L') && body[start + 2] == '=') {
-                    pl_commands++;
-                    size_t pos = start + 3;
-                    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
-                    int* current = &x1;
-                    
-                    while (pos < end) {
-                        if (isdigit(body[pos])) {
-                            *current = *current * 10 + (body[pos] - '0');
-                        } else if (body[pos] == 'x' || body[pos] == 'X') {
-                            if (current == &x1) current = &y1;
-                            else if (current == &x2) current = &y2;
-                        } else if (body[pos] == '-') {
-                            current = &x2;
-                        }
-                        pos++;
-                    }
-                    
-                    // Generate line
-                    if (y1 == y2) {
-                        int minX = min(x1, x2);
-                        int maxX = max(x1, x2);
-                        for (int x = minX; x <= maxX; x++) {
-                            pixels.push_back({x, y1});
-                        }
-                    } else if (x1 == x2) {
-                        int minY = min(y1, y2);
-                        int maxY = max(y1, y2);
-                        for (int y = minY; y <= maxY; y++) {
-                            pixels.push_back({x1, y});
-                        }
-                    }
+                if (*pos == 'x' || *pos == 'X') {
+                    if (current == &x1) current = &y1;
+                    else if (current == &x2) current = &y2;
+                } else if (*pos == '-') {
+                    current = &x2;
                 }
+                pos++;
             }
             
-            lineStart = i + 1;
+            // Keep the line as span(s) - never expand per pixel
+            if (y1 == y2) {
+                out.runs.push_back({min(x1, x2), max(x1, x2), y1});
+            } else if (x1 == x2) {
+                int minY = min(y1, y2);
+                int maxY = max(y1, y2);
+                for (int y = minY; y <= maxY; y++) {
+                    out.runs.push_back({x1, x1, y});
+                }
+            }
+        }
+        
+        if (nl == bodyEnd) break;
+        p = nl + 1;
+    }
+    
+    cmd.runCount = static_cast<uint32_t>(out.runs.size() - cmd.runOffset);
+    cmd.singleCount = static_cast<uint32_t>(out.singles.size() - cmd.singleOffset);
+    
+    HMICX_LOG(HMICX_LVL_TRACE, "    📊 Parsed " << p_commands << " P commands, " << pl_commands << " PL commands → "
+         << cmd.runCount << " runs, " << cmd.singleCount << " singles");
+}
+
+// 🗂️ foo.hmic → foo.hmicidx, anything else just gets ".hmicidx" tacked on
+string HMICX::indexPathFor(const string& hmicPath) {
+    if (hmicPath.size() >= 5) {
+        string ext = hmicPath.substr(hmicPath.size() - 5);
+        transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == ".hmic") return hmicPath + "idx";
+    }
+    return hmicPath + ".hmicidx";
+}
+
+bool HMICX::saveIndex(const string& indexPath, const BlockIndex& idx) {
+    ofstream out(indexPath, ios::binary);
+    if (!out.is_open()) return false;
+    
+    IndexFileHeader hdr;
+    hdr.fileSize = idx.fileSize;
+    hdr.fileMtime = idx.fileMtime;
+    hdr.headerOffset = idx.header.offset;
+    hdr.headerLength = idx.header.length;
+    hdr.hasHeader = idx.hasHeader ? 1 : 0;
+    hdr.blockCount = idx.blocks.size();
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    
+    vector<IndexFileEntry> entries;
+    vector<int32_t> ranges;  // (start, end) pairs of every multi-range block
+    entries.reserve(idx.blocks.size());
+    for (const BlockSpan& b : idx.blocks) {
+        entries.push_back({b.offset, b.length, b.start, b.end, static_cast<uint32_t>(b.ranges.size())});
+        for (const auto& [lo, hi] : b.ranges) {
+            ranges.push_back(lo);
+            ranges.push_back(hi);
         }
     }
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexFileEntry));
+    out.write(reinterpret_cast<const char*>(ranges.data()), ranges.size() * sizeof(int32_t));
     
-    cout << "[DEBUG]     📊 Parsed " << p_commands << " P commands, " << pl_commands << " PL commands → " << pixels.size() << " total pixels" << endl;
+    return bool(out);
+}
+
+bool HMICX::loadIndex(const string& indexPath, BlockIndex& idx) {
+    ifstream in(indexPath, ios::binary);
+    if (!in.is_open()) return false;
+    
+    IndexFileHeader hdr;
+    if (!in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr))) return false;
+    if (memcmp(hdr.magic, "HMICIDX", 7) != 0 || hdr.version != 2) return false;  // old versions just get rebuilt
+    
+    vector<IndexFileEntry> entries(hdr.blockCount);
+    if (!in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(IndexFileEntry))) return false;
     
-    return pixels;
+    idx.fileSize = hdr.fileSize;
+    idx.fileMtime = hdr.fileMtime;
+    idx.header = {hdr.headerOffset, hdr.headerLength, 0, 0};
+    idx.hasHeader = hdr.hasHeader != 0;
+    idx.blocks.clear();
+    idx.blocks.reserve(entries.size());
+    for (const IndexFileEntry& e : entries) {
+        BlockSpan b{e.offset, e.length, e.start, e.end, {}};
+        if (e.rangeCount) {
+            vector<int32_t> r(size_t(e.rangeCount) * 2);
+            if (!in.read(reinterpret_cast<char*>(r.data()), r.size() * sizeof(int32_t))) return false;
+            for (size_t k = 0; k < r.size(); k += 2) b.ranges.push_back({r[k], r[k + 1]});
+        }
+        idx.blocks.push_back(std::move(b));
+    }
+    return true;
 }
 
-map<string, string> Parser::getHeader() const {
-    return header;
+const char* HMICX::assetKindName(AssetKind kind) {
+    switch (kind) {
+        case AssetKind::HMIC7: return "hmic7";
+        case AssetKind::HMICP: return "hmicp";
+        case AssetKind::HMICP7: return "hmicp7";
+        default: return "hmic";
+    }
 }
 
-vector<Command> Parser::getCommands() const {
-    return commands;
-}
\ No newline at end of file
+// 🔎 PROBE SOURCE - hands out the file's bytes (or its decompressed bytes) a
+// little at a time, so probe() stops reading the moment it has a header.
+namespace {
+    constexpr size_t PROBE_READ = 4096;  // first read: header + a bit, usually all we need
+    
+    // one DStream per thread, reused across files (its window buffer is the
+    // expensive part and the catalog tool probes thousands of files per thread)
+    struct ProbeDStream {
+        ZSTD_DStream* ds = ZSTD_createDStream();
+        ~ProbeDStream() { ZSTD_freeDStream(ds); }
+    };
+    
+    struct ProbeSource {
+        int fd = -1;
+        bool compressed = false;
+        bool eof = false;
+        uint64_t bytesRead = 0;
+        string raw;                 // compressed bytes not fed to zstd yet
+        size_t rawPos = 0;
+        ZSTD_DStream* ds = nullptr;
+        
+        ~ProbeSource() { if (fd >= 0) close(fd); }
+        
+        size_t readRaw(char* dst, size_t cap) {
+            ssize_t n;
+            do { n = read(fd, dst, cap); } while (n < 0 && errno == EINTR);
+            if (n < 0) throw runtime_error(string("Read failed: ") + strerror(errno));
+            bytesRead += n;
+            return size_t(n);
+        }
+        
+        // Append the next bit of (decompressed) content to `out`. False = nothing left.
+        bool more(string& out) {
+            if (eof) return false;
+            if (!compressed) {
+                size_t old = out.size();
+                out.resize(old + PROBE_READ);
+                size_t n = readRaw(&out[old], PROBE_READ);
+                out.resize(old + n);
+                if (n == 0) eof = true;
+                return n > 0;
+            }
+            
+            // zstd only emits whole blocks, so keep feeding until something comes out
+            char buf[PROBE_READ];
+            for (;;) {
+                ZSTD_inBuffer in{raw.data(), raw.size(), rawPos};
+                ZSTD_outBuffer zout{buf, sizeof(buf), 0};
+                size_t ret = ZSTD_decompressStream(ds, &zout, &in);
+                if (ZSTD_isError(ret)) throw runtime_error(string("zstd: ") + ZSTD_getErrorName(ret));
+                rawPos = in.pos;
+                if (zout.pos > 0) {
+                    out.append(buf, zout.pos);
+                    return true;
+                }
+                if (rawPos < raw.size()) continue;
+                
+                raw.resize(PROBE_READ);
+                size_t n = readRaw(&raw[0], raw.size());
+                raw.resize(n);
+                rawPos = 0;
+                if (n == 0) {
+                    eof = true;
+                    return false;
+                }
+            }
+        }
+    };
+    
+    // Top-level info{ ... } finder that survives being fed more bytes. Hops brace
+    // to brace with the SIMD kernel; only a '{' at depth 0 can open info.
+    struct InfoFinder {
+        size_t pos = 0;
+        int depth = 0;
+        size_t bodyStart = string::npos;
+        
+        bool feed(string_view s, string_view& body) {
+            const char* base = s.data();
+            const char* end = base + s.size();
+            for (const char* p = findBrace(base + pos, end); p < end; p = findBrace(p + 1, end)) {
+                size_t i = p - base;
+                if (*p == '{') {
+                    if (depth == 0 && bodyStart == string::npos && precededByInfo(s, i)) bodyStart = i + 1;
+                    depth++;
+                } else if (depth > 0 && --depth == 0 && bodyStart != string::npos) {
+                    body = s.substr(bodyStart, i - bodyStart);
+                    return true;
+                }
+            }
+            pos = s.size();
+            return false;
+        }
+        
+        // "info" (any case, spaces allowed before the brace) right in front of s[brace]
+        static bool precededByInfo(string_view s, size_t brace) {
+            size_t j = brace;
+            while (j > 0 && isSpaceC(s[j - 1])) j--;
+            if (j < 4 || !fastStartsWith(s.data() + j - 4, 4, "info", 4)) return false;
+            return j == 4 || !isalnum(static_cast<unsigned char>(s[j - 5]));
+        }
+        
+        // bytes before this are settled and can be dropped (not inside info{})
+        size_t settled() const { return bodyStart == string::npos ? pos : 0; }
+        void dropped(size_t n) { pos -= n; }
+    };
+}
+
+ProbeInfo HMICX::probe(const string& path) {
+    static thread_local ProbeDStream dstream;
+    
+    ProbeSource src;
+    src.fd = open(path.c_str(), O_RDONLY);
+    if (src.fd < 0) throw runtime_error("Cannot open file: " + path);
+    
+    ProbeInfo info;
+    struct stat st;
+    if (fstat(src.fd, &st) == 0) info.fileSize = st.st_size;
+    
+    // sniff: zstd or not decides where the content bytes come from
+    string data;
+    string& raw = src.raw;
+    raw.resize(PROBE_READ);
+    raw.resize(src.readRaw(&raw[0], raw.size()));
+    if (isZstd(raw.data(), raw.size())) {
+        if (!dstream.ds) throw runtime_error("Cannot create ZSTD_DStream");
+        ZSTD_initDStream(dstream.ds);  // reset from whatever file this thread probed last
+        src.compressed = true;
+        src.ds = dstream.ds;
+    } else {
+        data.swap(raw);
+        if (data.empty()) src.eof = true;
+    }
+    
+    while (data.size() < 5 && src.more(data)) {}
+    
+    // 🎨 HMICP: the whole answer is the first 24 bytes
+    if (data.size() >= 5 && memcmp(data.data(), "HMICP", 5) == 0) {
+        while (data.size() < sizeof(HMICPHeader) && src.more(data)) {}
+        if (data.size() < sizeof(HMICPHeader)) throw runtime_error("Truncated HMICP header: " + path);
+        
+        HMICPHeader hdr;
+        memcpy(&hdr, data.data(), sizeof(hdr));
+        info.kind = src.compressed ? AssetKind::HMICP7 : AssetKind::HMICP;
+        info.width = hdr.width;
+        info.height = hdr.height;
+        info.fps = hdr.fps;
+        info.frames = hdr.totalFrames;
+        info.loop = hdr.loop != 0;
+        info.bytesRead = src.bytesRead;
+        return info;
+    }
+    
+    // 📋 HMIC text: read until the info{} block closes. Frame blocks in front
+    // of it are skipped over and thrown away so memory stays small.
+    info.kind = src.compressed ? AssetKind::HMIC7 : AssetKind::HMIC;
+    InfoFinder finder;
+    string_view body;
+    while (!finder.feed(data, body)) {
+        size_t drop = finder.settled();
+        if (drop > BUFFER_SIZE) {
+            data.erase(0, drop);
+            finder.dropped(drop);
+        }
+        if (!src.more(data)) throw runtime_error("No info{} block in " + path);
+    }
+    
+    map<string, string> header;
+    parseHeaderLines(body, header);
+    for (const auto& [k, val] : header) {
+        if (k == "DISPLAY") {
+            string v = val;
+            transform(v.begin(), v.end(), v.begin(), ::tolower);
+            if (sscanf(v.c_str(), "%dx%d", &info.width, &info.height) != 2) info.width = info.height = 0;
+        } else if (k == "FPS") {
+            info.fps = atoi(val.c_str());
+        } else if (k == "F") {
+            info.frames = atoi(val.c_str());
+        } else if (k == "LOOP") {
+            info.loop = (val == "Y" || val == "y" || val == "1");
+        }
+    }
+    info.bytesRead = src.bytesRead;
+    HMICX_LOG(HMICX_LVL_INFO, "🔎 Probed " << path << ": " << assetKindName(info.kind) << " " << info.width << "x"
+              << info.height << " @ " << info.fps << " FPS, " << info.frames << " frames (read "
+              << info.bytesRead << "/" << info.fileSize << " bytes)");
+    return info;
+}
+
+ostream& HMICX::operator<<(ostream& os, const ParseStats& st) {
+    auto ms = [](uint64_t ns) { return ns / 1e6; };
+    os << st.bytesRead << " bytes, " << st.blocks << " blocks, " << st.commands << " commands, "
+       << st.runs << " runs + " << st.singles << " singles = " << st.pixels << " pixels | "
+       << "scan " << ms(st.scanNs) << "ms, frames " << ms(st.frameNs) << "ms, merge "
+       << ms(st.mergeNs) << "ms, total " << ms(st.totalNs) << "ms";
+    return os;
+}
@@ -0,0 +1,298 @@
+#include "hmicx_raster.h"
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+using namespace HMICX;
+
+void Framebuffer::resize(int width, int height) {
+    w = max(width, 0);
+    h = max(height, 0);
+    pixels.assign(size_t(w) * h, 0);
+}
+
+size_t Framebuffer::draw(Span<Run> runs, Span<Pixel> singles, uint32_t color, Blend blend) {
+    size_t drawn = 0;
+    for (const Run& r : runs) {
+        fillRun(r.x0, r.x1, r.y, color, blend);
+        drawn += size_t(r.x1 - r.x0 + 1);
+    }
+    for (const Pixel& p : singles) plot(p.x, p.y, color, blend);
+    return drawn + singles.size();
+}
+
+size_t HMICX::rasterizeFrame(Framebuffer& fb, const CommandList& cmds, int frame, uint32_t background) {
+    fb.clear(background);
+    size_t drawn = 0;
+    for (const Command& c : cmds) {
+        if (!cmds.onFrame(c, frame)) continue;
+        drawn += fb.draw(cmds.runsOf(c), cmds.singlesOf(c), opaque(c.rgba));
+    }
+    HMICX_LOG(HMICX_LVL_BLOCK, "🖼️ Rasterized frame " << frame << ": " << drawn << " pixels");
+    return drawn;
+}
+
+size_t HMICX::rasterizeFrame(Framebuffer& fb, const CommandList& cmds, const FrameIndex& index, uint32_t background) {
+    fb.clear(background);
+    size_t drawn = 0;
+    for (uint32_t i : index.active()) {
+        const Command& c = cmds[i];
+        drawn += fb.draw(cmds.runsOf(c), cmds.singlesOf(c), opaque(c.rgba));
+    }
+    HMICX_LOG(HMICX_LVL_BLOCK, "🖼️ Rasterized frame " << index.frame() << ": " << index.active().size()
+              << "/" << cmds.size() << " commands, " << drawn << " pixels");
+    return drawn;
+}
+
+// 🧵 Helper threads that live as long as the rasterizer. run() hands every
+// helper the same job, does it on the calling thread too and returns once all
+// of them are done; between runs the helpers sleep on a condition variable.
+struct BandedRasterizer::Crew {
+    mutex m;
+    condition_variable start, finished;
+    const function<void()>* job = nullptr;
+    uint64_t round = 0;
+    unsigned busy = 0;
+    bool stopping = false;
+    mutex running;  // one run() at a time, rasterize() stays safe to call from anywhere
+    vector<thread> helpers;
+
+    explicit Crew(unsigned count) {
+        for (unsigned i = 0; i < count; i++) {
+            helpers.emplace_back([this]() {
+                uint64_t seen = 0;
+                unique_lock<mutex> lock(m);
+                for (;;) {
+                    start.wait(lock, [&]() { return stopping || round != seen; });
+                    if (stopping) return;
+                    seen = round;
+                    const function<void()>& work = *job;
+                    lock.unlock();
+                    work();
+                    lock.lock();
+                    if (--busy == 0) finished.notify_one();
+                }
+            });
+        }
+    }
+
+    ~Crew() {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        start.notify_all();
+        for (auto& t : helpers) t.join();
+    }
+
+    void run(const function<void()>& work) {
+        lock_guard<mutex> one(running);
+        {
+            lock_guard<mutex> lock(m);
+            job = &work;
+            busy = unsigned(helpers.size());
+            round++;
+        }
+        start.notify_all();
+        work();  // this thread pitches in too
+        unique_lock<mutex> lock(m);
+        finished.wait(lock, [&]() { return busy == 0; });
+    }
+};
+
+BandedRasterizer::~BandedRasterizer() = default;
+
+BandedRasterizer::BandedRasterizer(const CommandList& cmds, int width, int height, unsigned threadCount, Blend blend)
+    : cmds(cmds), w(max(width, 0)), h(max(height, 0)), blend(blend) {
+    threads = threadCount ? threadCount : max(1u, thread::hardware_concurrency());
+
+    // ~4 bands per thread, each a multiple of 16 rows (16 * width * 4 bytes is
+    // always a whole number of 64-byte cache lines)
+    const int rowsPerBand = max(16, (h / int(threads * 4) + 15) / 16 * 16);
+    const int bandTotal = max(1, (h + rowsPerBand - 1) / rowsPerBand);
+    threads = min<unsigned>(threads, bandTotal);
+    bands.resize(bandTotal);
+    for (int b = 0; b < bandTotal; b++) {
+        bands[b].y0 = b * rowsPerBand + 1;
+        bands[b].y1 = min(h, (b + 1) * rowsPerBand);
+    }
+
+    // 🪣 bucket in file order: a command's runs/singles in a band end up as one
+    // contiguous piece, pieces in the order the commands come
+    auto pieceFor = [&](Band& band, uint32_t ci) -> Piece& {
+        if (band.pieces.empty() || band.pieces.back().command != ci) {
+            band.pieces.push_back({ci, uint32_t(band.runs.size()), 0, uint32_t(band.singles.size()), 0});
+        }
+        return band.pieces.back();
+    };
+    for (uint32_t ci = 0; ci < cmds.size(); ci++) {
+        const Command& c = cmds[ci];
+        for (const Run& r : cmds.runsOf(c)) {
+            if (r.y < 1 || r.y > h) continue;
+            Band& band = bands[(r.y - 1) / rowsPerBand];
+            pieceFor(band, ci).runCount++;
+            band.runs.push_back(r);
+        }
+        for (const Pixel& p : cmds.singlesOf(c)) {
+            if (p.y < 1 || p.y > h) continue;
+            Band& band = bands[(p.y - 1) / rowsPerBand];
+            pieceFor(band, ci).singleCount++;
+            band.singles.push_back(p);
+        }
+    }
+    if (threads > 1) crew = make_unique<Crew>(threads - 1);
+    HMICX_LOG(HMICX_LVL_INFO, "🧵 Banded rasterizer: " << bandTotal << " bands of " << rowsPerBand
+              << " rows on " << threads << " threads");
+}
+
+template <typename Active>
+size_t BandedRasterizer::drawBands(Framebuffer& fb, uint32_t background, const Active& active) const {
+    if (fb.width() != w || fb.height() != h) fb.resize(w, h);
+
+    atomic<size_t> next{0};
+    atomic<size_t> drawn{0};
+    function<void()> worker = [&]() {
+        size_t mine = 0;
+        for (size_t b = next++; b < bands.size(); b = next++) {
+            const Band& band = bands[b];
+            if (band.y1 < band.y0) continue;
+            fill(fb.row(band.y0 - 1), fb.row(band.y1), background);
+            for (const Piece& pc : band.pieces) {
+                if (!active(pc.command)) continue;
+                const Command& c = cmds[pc.command];
+                uint32_t color = blend == Blend::Opaque ? opaque(c.rgba) : c.rgba;
+                mine += fb.draw(Span<Run>{band.runs.data() + pc.runOffset, pc.runCount},
+                                Span<Pixel>{band.singles.data() + pc.singleOffset, pc.singleCount}, color, blend);
+            }
+        }
+        drawn += mine;
+    };
+
+    if (crew) crew->run(worker);
+    else worker();
+    return drawn;
+}
+
+size_t BandedRasterizer::rasterize(Framebuffer& fb, int frame, uint32_t background) const {
+    size_t drawn = drawBands(fb, background, [&](uint32_t ci) { return cmds.onFrame(cmds[ci], frame); });
+    HMICX_LOG(HMICX_LVL_BLOCK, "🧵 Rasterized frame " << frame << " in " << bands.size() << " bands: "
+              << drawn << " pixels");
+    return drawn;
+}
+
+size_t BandedRasterizer::rasterize(Framebuffer& fb, const FrameIndex& index, uint32_t background) const {
+    vector<uint8_t> on(cmds.size(), 0);
+    for (uint32_t i : index.active()) on[i] = 1;
+    size_t drawn = drawBands(fb, background, [&](uint32_t ci) { return on[ci] != 0; });
+    HMICX_LOG(HMICX_LVL_BLOCK, "🧵 Rasterized frame " << index.frame() << " in " << bands.size() << " bands: "
+              << index.active().size() << "/" << cmds.size() << " commands, " << drawn << " pixels");
+    return drawn;
+}
+
+Compositor::Compositor(const CommandList& cmds, int width, int height, Blend blend, uint32_t background)
+    : cmds(cmds), index(cmds), fb(width, height), blend(blend), background(background) {
+    dirty.assign(max(height, 0), 0);
+
+    // row extent of every command, so the incremental path can skip the ones
+    // nowhere near the dirty rows without looking at their runs
+    ys.reserve(cmds.size());
+    for (const Command& c : cmds) {
+        int lo = INT_MAX, hi = INT_MIN;
+        for (const Run& r : cmds.runsOf(c)) { lo = min(lo, r.y); hi = max(hi, r.y); }
+        for (const Pixel& p : cmds.singlesOf(c)) { lo = min(lo, p.y); hi = max(hi, p.y); }
+        ys.push_back({lo, hi});
+    }
+}
+
+void Compositor::setThreadCount(unsigned n) {
+    n = n ? n : max(1u, thread::hardware_concurrency());
+    banded.reset();
+    if (n > 1) {
+        banded = make_unique<BandedRasterizer>(cmds, fb.width(), fb.height(), n, blend);
+        if (banded->threadCount() < 2) banded.reset();  // too small to split
+    }
+}
+
+Compositor::Rows Compositor::redraw(int frame) {
+    index.moveTo(frame);
+    if (banded) {
+        banded->rasterize(fb, index, background);
+    } else {
+        fb.clear(background);
+        for (uint32_t i : index.active()) {
+            const Command& c = cmds[i];
+            fb.draw(cmds.runsOf(c), cmds.singlesOf(c), colorOf(c), blend);
+        }
+    }
+    prev = index.active();
+    valid = true;
+    stats.fullRedraws++;
+    HMICX_LOG(HMICX_LVL_BLOCK, "🧩 Frame " << frame << ": full redraw, " << prev.size() << " commands");
+    return {0, fb.height() - 1};
+}
+
+Compositor::Rows Compositor::render(int frame) {
+    if (!valid || frame != index.frame() + 1) return redraw(frame);
+
+    index.next();
+    const vector<uint32_t>& now = index.active();
+
+    // what ended or started = symmetric difference (both lists are in file order)
+    changed.clear();
+    set_symmetric_difference(prev.begin(), prev.end(), now.begin(), now.end(), back_inserter(changed));
+    if (changed.empty()) {
+        stats.unchanged++;
+        return {};
+    }
+
+    // 🚩 rows those commands touch get repainted from scratch
+    const int h = fb.height();
+    Rows rows{h, -1};
+    auto mark = [&](int y) {
+        if (y < 1 || y > h) return;
+        dirty[y - 1] = 1;
+        rows.first = min(rows.first, y - 1);
+        rows.last = max(rows.last, y - 1);
+    };
+    for (uint32_t i : changed) {
+        const Command& c = cmds[i];
+        for (const Run& r : cmds.runsOf(c)) mark(r.y);
+        for (const Pixel& p : cmds.singlesOf(c)) mark(p.y);
+    }
+    if (rows.empty()) {  // everything that changed was off-screen
+        prev = now;
+        stats.unchanged++;
+        return {};
+    }
+
+    for (int y = rows.first; y <= rows.last; y++) {
+        if (dirty[y]) fill_n(fb.row(y), fb.width(), background);
+    }
+    for (uint32_t i : now) {
+        if (ys[i].second < rows.first + 1 || ys[i].first > rows.last + 1) continue;
+        const Command& c = cmds[i];
+        uint32_t color = colorOf(c);
+        for (const Run& r : cmds.runsOf(c)) {
+            if (r.y >= 1 && r.y <= h && dirty[r.y - 1]) fb.fillRun(r.x0, r.x1, r.y, color, blend);
+        }
+        for (const Pixel& p : cmds.singlesOf(c)) {
+            if (p.y >= 1 && p.y <= h && dirty[p.y - 1]) fb.plot(p.x, p.y, color, blend);
+        }
+    }
+
+    int repainted = 0;
+    for (int y = rows.first; y <= rows.last; y++) {
+        repainted += dirty[y];
+        dirty[y] = 0;
+    }
+    prev = now;
+    stats.incremental++;
+    stats.rowsRepainted += repainted;
+    HMICX_LOG(HMICX_LVL_BLOCK, "🧩 Frame " << frame << ": " << changed.size() << " commands changed, repainted "
+              << repainted << " rows");
+    return rows;
+}
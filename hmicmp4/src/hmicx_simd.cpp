@@ -0,0 +1,140 @@
+#include "hmicx.h"
+
+// 🏎️ SIMD TOKEN SCANNING - the parser spends most of its life looking for the
+// next brace or the next newline, so those two searches get vector kernels.
+// Everything is compiled into the same binary with per-function target
+// attributes and picked ONCE at startup from CPUID, so one build runs on
+// anything and still uses AVX2 where it exists.
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HMICX_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define HMICX_X86_SIMD 0
+#endif
+
+using namespace std;
+using namespace HMICX;
+
+// 🐢 scalar fallback (also does the tails of the vector versions)
+static const char* findBraceScalar(const char* p, const char* end) {
+    while (p < end && *p != '{' && *p != '}') p++;
+    return p;
+}
+
+static const char* findNewlineScalar(const char* p, const char* end) {
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+#if HMICX_X86_SIMD
+
+// SSE4.2: PCMPESTRI does "first byte equal to any of these" in one instruction
+__attribute__((target("sse4.2")))
+static const char* findBraceSSE42(const char* p, const char* end) {
+    const __m128i needles = _mm_setr_epi8('{', '}', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int idx = _mm_cmpestri(needles, 2, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY);
+        if (idx < 16) return p + idx;
+        p += 16;
+    }
+    return findBraceScalar(p, end);
+}
+
+__attribute__((target("sse4.2")))
+static const char* findNewlineSSE42(const char* p, const char* end) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return findNewlineScalar(p, end);
+}
+
+// AVX2: 32 bytes per compare, movemask + ctz finds the first hit
+__attribute__((target("avx2")))
+static const char* findBraceAVX2(const char* p, const char* end) {
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, open), _mm256_cmpeq_epi8(chunk, close));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return findBraceSSE42(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* findNewlineAVX2(const char* p, const char* end) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return findNewlineSSE42(p, end);
+}
+
+#endif
+
+static SimdLevel bestSupported() {
+#if HMICX_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return SimdLevel::SSE42;
+#endif
+    return SimdLevel::Scalar;
+}
+
+static SimdLevel active = SimdLevel::Scalar;
+
+// constant-initialized to scalar, so anything running before the dispatcher
+// below is still correct (just slower)
+const char* (*HMICX::detail::findBraceFn)(const char*, const char*) = findBraceScalar;
+const char* (*HMICX::detail::findNewlineFn)(const char*, const char*) = findNewlineScalar;
+
+SimdLevel HMICX::setSimdLevel(SimdLevel want) {
+    if (want > bestSupported()) want = bestSupported();
+
+    switch (want) {
+#if HMICX_X86_SIMD
+        case SimdLevel::AVX2:
+            detail::findBraceFn = findBraceAVX2;
+            detail::findNewlineFn = findNewlineAVX2;
+            break;
+        case SimdLevel::SSE42:
+            detail::findBraceFn = findBraceSSE42;
+            detail::findNewlineFn = findNewlineSSE42;
+            break;
+#endif
+        default:
+            want = SimdLevel::Scalar;
+            detail::findBraceFn = findBraceScalar;
+            detail::findNewlineFn = findNewlineScalar;
+            break;
+    }
+    active = want;
+    HMICX_LOG(HMICX_LVL_INFO, "🏎️ SIMD kernels: " << simdLevelName(active));
+    return active;
+}
+
+SimdLevel HMICX::simdLevel() {
+    return active;
+}
+
+const char* HMICX::simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::SSE42: return "sse4.2";
+        default: return "scalar";
+    }
+}
+
+// 🚀 pick the best kernels before main() runs
+static const SimdLevel dispatched = HMICX::setSimdLevel(SimdLevel::AVX2);